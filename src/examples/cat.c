@@ -1,6 +1,7 @@
 /* cat.c
 
-   Prints files specified on command line to the console. */
+   Prints files specified on command line to the console, or
+   its standard input if there are none. */
 
 #include <stdio.h>
 #include <syscall.h>
@@ -10,6 +11,16 @@ main (int argc, char *argv[])
 {
   bool success = true;
   int i;
+
+  if (argc < 2)
+    {
+      char buffer[1024];
+      int bytes_read;
+
+      while ((bytes_read = read (STDIN_FILENO, buffer, sizeof buffer)) > 0)
+        write (STDOUT_FILENO, buffer, bytes_read);
+      return EXIT_SUCCESS;
+    }
   
   for (i = 1; i < argc; i++) 
     {
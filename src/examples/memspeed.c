@@ -0,0 +1,290 @@
+/* memspeed.c
+
+   Microbenchmark for the block primitives in lib/string.c.
+   Times memcpy(), memmove(), memset(), memcmp(), and strlen()
+   against simple byte-at-a-time versions across a range of
+   sizes and alignments, reporting the average number of CPU
+   cycles per call, as measured by the RDTSC instruction.
+
+   Usage: memspeed [ITERATIONS] */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+#define MAX_SIZE 4096
+#define DEFAULT_ITERATIONS 64
+
+static unsigned char src_buf[MAX_SIZE + 16];
+static unsigned char dst_buf[MAX_SIZE + 16];
+
+/* Receives the results of memcmp() and strlen(), so that the
+   compiler cannot discard calls to them as having no effect. */
+static volatile size_t sink;
+
+/* Byte-at-a-time reference versions.  NOINLINE keeps the
+   compiler from specializing them for each call site, which the
+   library versions are not subject to either. */
+#define NOINLINE __attribute__ ((noinline))
+
+static NOINLINE void *
+byte_memcpy (void *dst_, const void *src_, size_t size)
+{
+  unsigned char *dst = dst_;
+  const unsigned char *src = src_;
+
+  while (size-- > 0)
+    *dst++ = *src++;
+  return dst_;
+}
+
+static NOINLINE void *
+byte_memmove (void *dst_, const void *src_, size_t size)
+{
+  unsigned char *dst = dst_;
+  const unsigned char *src = src_;
+
+  if (dst < src)
+    {
+      while (size-- > 0)
+        *dst++ = *src++;
+    }
+  else
+    {
+      dst += size;
+      src += size;
+      while (size-- > 0)
+        *--dst = *--src;
+    }
+  return dst_;
+}
+
+static NOINLINE void *
+byte_memset (void *dst_, int value, size_t size)
+{
+  unsigned char *dst = dst_;
+
+  while (size-- > 0)
+    *dst++ = value;
+  return dst_;
+}
+
+static NOINLINE int
+byte_memcmp (const void *a_, const void *b_, size_t size)
+{
+  const unsigned char *a = a_;
+  const unsigned char *b = b_;
+
+  for (; size-- > 0; a++, b++)
+    if (*a != *b)
+      return *a > *b ? +1 : -1;
+  return 0;
+}
+
+static NOINLINE size_t
+byte_strlen (const char *string)
+{
+  const char *p;
+
+  for (p = string; *p != '\0'; p++)
+    continue;
+  return p - string;
+}
+
+/* Returns the CPU's time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* One operation under test, in both versions.  Each function
+   performs the operation on SIZE bytes at the given offsets
+   into the source and destination buffers. */
+struct bench
+  {
+    const char *name;
+    void (*byte) (size_t size, int src_ofs, int dst_ofs);
+    void (*word) (size_t size, int src_ofs, int dst_ofs);
+  };
+
+static void
+byte_memcpy_op (size_t size, int src_ofs, int dst_ofs)
+{
+  byte_memcpy (dst_buf + dst_ofs, src_buf + src_ofs, size);
+}
+
+static void
+word_memcpy_op (size_t size, int src_ofs, int dst_ofs)
+{
+  memcpy (dst_buf + dst_ofs, src_buf + src_ofs, size);
+}
+
+/* memmove() is measured on overlapping blocks within DST_BUF,
+   moving backward, which is the case memcpy() cannot handle. */
+static void
+byte_memmove_op (size_t size, int src_ofs, int dst_ofs)
+{
+  byte_memmove (dst_buf + src_ofs + dst_ofs + 4, dst_buf + src_ofs, size);
+}
+
+static void
+word_memmove_op (size_t size, int src_ofs, int dst_ofs)
+{
+  memmove (dst_buf + src_ofs + dst_ofs + 4, dst_buf + src_ofs, size);
+}
+
+static void
+byte_memset_op (size_t size, int src_ofs UNUSED, int dst_ofs)
+{
+  byte_memset (dst_buf + dst_ofs, 0x5a, size);
+}
+
+static void
+word_memset_op (size_t size, int src_ofs UNUSED, int dst_ofs)
+{
+  memset (dst_buf + dst_ofs, 0x5a, size);
+}
+
+/* memcmp() and strlen() run over blocks that are equal and
+   nonzero for their full length, which is their worst case. */
+static void
+byte_memcmp_op (size_t size, int src_ofs, int dst_ofs)
+{
+  sink = byte_memcmp (dst_buf + dst_ofs, src_buf + src_ofs, size);
+}
+
+static void
+word_memcmp_op (size_t size, int src_ofs, int dst_ofs)
+{
+  sink = memcmp (dst_buf + dst_ofs, src_buf + src_ofs, size);
+}
+
+static void
+byte_strlen_op (size_t size UNUSED, int src_ofs, int dst_ofs UNUSED)
+{
+  sink = byte_strlen ((char *) src_buf + src_ofs);
+}
+
+static void
+word_strlen_op (size_t size UNUSED, int src_ofs, int dst_ofs UNUSED)
+{
+  sink = strlen ((char *) src_buf + src_ofs);
+}
+
+static const struct bench benches[] =
+  {
+    {"memcpy", byte_memcpy_op, word_memcpy_op},
+    {"memmove", byte_memmove_op, word_memmove_op},
+    {"memset", byte_memset_op, word_memset_op},
+    {"memcmp", byte_memcmp_op, word_memcmp_op},
+    {"strlen", byte_strlen_op, word_strlen_op},
+  };
+
+static const size_t sizes[] = {8, 32, 128, 512, 2048, MAX_SIZE - 8};
+
+/* Fills the source buffer with nonzero bytes, terminated after
+   SIZE bytes at SRC_OFS for the sake of strlen(), and makes the
+   destination buffer equal to it for the sake of memcmp(). */
+static void
+prepare (size_t size, int src_ofs, int dst_ofs)
+{
+  size_t i;
+
+  for (i = 0; i < sizeof src_buf; i++)
+    src_buf[i] = 'a' + i % 26;
+  src_buf[src_ofs + size] = '\0';
+  memcpy (dst_buf + dst_ofs, src_buf + src_ofs, size);
+}
+
+/* Returns the average cycles per call of running FUNC
+   ITERATIONS times. */
+static unsigned
+measure (void (*func) (size_t, int, int), int iterations,
+         size_t size, int src_ofs, int dst_ofs)
+{
+  uint64_t start;
+  int i;
+
+  prepare (size, src_ofs, dst_ofs);
+  func (size, src_ofs, dst_ofs);
+  start = rdtsc ();
+  for (i = 0; i < iterations; i++)
+    func (size, src_ofs, dst_ofs);
+  return (rdtsc () - start) / iterations;
+}
+
+/* Checks that each word-at-a-time primitive agrees with its
+   byte-at-a-time counterpart for SIZE bytes at the given
+   offsets.  Returns true if so. */
+static bool
+verify (size_t size, int src_ofs, int dst_ofs)
+{
+  static unsigned char expect[sizeof dst_buf];
+
+  prepare (size, src_ofs, dst_ofs);
+  if (strlen ((char *) src_buf + src_ofs) != size
+      || memcmp (dst_buf + dst_ofs, src_buf + src_ofs, size) != 0)
+    return false;
+  if (size > 0)
+    {
+      dst_buf[dst_ofs + size - 1]++;
+      if (memcmp (dst_buf + dst_ofs, src_buf + src_ofs, size) <= 0)
+        return false;
+    }
+
+  memcpy (expect, dst_buf, sizeof dst_buf);
+  byte_memmove (expect + src_ofs + dst_ofs + 4, expect + src_ofs, size);
+  memmove (dst_buf + src_ofs + dst_ofs + 4, dst_buf + src_ofs, size);
+  if (byte_memcmp (expect, dst_buf, sizeof dst_buf))
+    return false;
+
+  byte_memset (expect + dst_ofs, 0xa5, size);
+  memset (dst_buf + dst_ofs, 0xa5, size);
+  return byte_memcmp (expect, dst_buf, sizeof dst_buf) == 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+  int iterations = argc > 1 ? atoi (argv[1]) : DEFAULT_ITERATIONS;
+  size_t b, s;
+  int src_ofs, dst_ofs;
+
+  if (iterations <= 0)
+    iterations = DEFAULT_ITERATIONS;
+
+  for (s = 0; s < sizeof sizes / sizeof *sizes; s++)
+    for (src_ofs = 0; src_ofs < 4; src_ofs++)
+      for (dst_ofs = 0; dst_ofs < 4; dst_ofs++)
+        if (!verify (sizes[s], src_ofs, dst_ofs))
+          {
+            printf ("memspeed: mismatch at size %zu, offsets %d/%d\n",
+                    sizes[s], src_ofs, dst_ofs);
+            return EXIT_FAILURE;
+          }
+
+  printf ("%-8s %5s %7s %10s %10s %7s\n",
+          "func", "size", "src/dst", "byte", "word", "speedup");
+  for (b = 0; b < sizeof benches / sizeof *benches; b++)
+    for (s = 0; s < sizeof sizes / sizeof *sizes; s++)
+      for (src_ofs = 0; src_ofs < 4; src_ofs += 3)
+        for (dst_ofs = 0; dst_ofs < 4; dst_ofs += 3)
+          {
+            const struct bench *bench = &benches[b];
+            unsigned byte = measure (bench->byte, iterations,
+                                     sizes[s], src_ofs, dst_ofs);
+            unsigned word = measure (bench->word, iterations,
+                                     sizes[s], src_ofs, dst_ofs);
+
+            printf ("%-8s %5zu %5d/%d %10u %10u %6u%%\n",
+                    bench->name, sizes[s], src_ofs, dst_ofs,
+                    byte, word, word ? byte * 100 / word : 0);
+          }
+
+  return EXIT_SUCCESS;
+}
@@ -5,6 +5,7 @@
 
 static void read_line (char line[], size_t);
 static bool backspace (char **pos, char line[]);
+static void run_pipeline (char *command);
 
 int
 main (void)
@@ -30,6 +31,8 @@ main (void)
         {
           /* Empty command. */
         }
+      else if (strchr (command, '|') != NULL)
+        run_pipeline (command);
       else
         {
           pid_t pid = exec (command);
@@ -44,6 +47,80 @@ main (void)
   return EXIT_SUCCESS;
 }
 
+/* Maximum number of commands in a pipeline. */
+#define MAX_STAGES 8
+
+/* Runs COMMAND, a pipeline of commands separated by "|", each
+   with its standard output going to the standard input of the
+   next, and waits for all of them. */
+static void
+run_pipeline (char *command)
+{
+  char *stages[MAX_STAGES];
+  pid_t pids[MAX_STAGES];
+  int stage_cnt = 0;
+  int saved_in, saved_out;
+  char *stage, *save_ptr;
+  int i;
+
+  for (stage = strtok_r (command, "|", &save_ptr); stage != NULL;
+       stage = strtok_r (NULL, "|", &save_ptr))
+    {
+      if (stage_cnt >= MAX_STAGES)
+        {
+          printf ("pipeline too long\n");
+          return;
+        }
+      stages[stage_cnt++] = stage;
+    }
+
+  /* Keep our own standard input and output out of the way of
+     the commands. */
+  saved_in = dup (STDIN_FILENO);
+  saved_out = dup (STDOUT_FILENO);
+  fcntl (saved_in, F_SETFD, FD_CLOEXEC);
+  fcntl (saved_out, F_SETFD, FD_CLOEXEC);
+
+  for (i = 0; i < stage_cnt; i++)
+    {
+      int fds[2] = {-1, -1};
+
+      if (i + 1 < stage_cnt && pipe (fds) == 0)
+        {
+          /* The command gets the write end as its standard
+             output, and must not keep the read end open. */
+          fcntl (fds[0], F_SETFD, FD_CLOEXEC);
+          dup2 (fds[1], STDOUT_FILENO);
+          close (fds[1]);
+        }
+      else
+        dup2 (saved_out, STDOUT_FILENO);
+
+      pids[i] = exec (stages[i]);
+
+      /* The next command reads what this one writes, or nothing
+         if there is no pipe. */
+      if (fds[0] >= 0)
+        {
+          dup2 (fds[0], STDIN_FILENO);
+          close (fds[0]);
+        }
+      else
+        close (STDIN_FILENO);
+    }
+
+  dup2 (saved_in, STDIN_FILENO);
+  dup2 (saved_out, STDOUT_FILENO);
+  close (saved_in);
+  close (saved_out);
+
+  for (i = 0; i < stage_cnt; i++)
+    if (pids[i] != PID_ERROR)
+      printf ("\"%s\": exit code %d\n", stages[i], wait (pids[i]));
+    else
+      printf ("\"%s\": exec failed\n", stages[i]);
+}
+
 /* Reads a line of input from the user into LINE, which has room
    for SIZE bytes.  Handles backspace and Ctrl+U in the ways
    expected by Unix users.  On return, LINE will always be
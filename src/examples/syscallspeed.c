@@ -0,0 +1,129 @@
+/* syscallspeed.c
+
+   Microbenchmark for system call entry and exit.  Times a
+   nearly null system call, sbrk(0), which the kernel answers
+   with no more work than an uncontended acquire and release of
+   the process's mappings lock, entering the kernel both
+   through "int $0x30" and through SYSENTER, and reports the
+   average number of CPU cycles per call, as measured by the
+   RDTSC instruction.  The SYSENTER path is skipped if the CPU
+   does not support it.
+
+   Usage: syscallspeed [ITERATIONS] */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include <syscall-nr.h>
+
+#define DEFAULT_ITERATIONS 10000
+
+/* Number of times to repeat each measurement, keeping the
+   fastest, to filter out timer interrupts and the like. */
+#define ROUNDS 5
+
+/* Returns the CPU's time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Returns true if the CPU supports SYSENTER, by the same test as
+   syscall_select() in lib/user/syscall.c. */
+static bool
+have_sysenter (void)
+{
+  uint32_t eax, ebx, ecx, edx;
+  unsigned family, model, stepping;
+
+  asm ("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (1));
+  family = (eax >> 8) & 0xf;
+  model = (eax >> 4) & 0xf;
+  stepping = eax & 0xf;
+  return ((edx & (1u << 11)) != 0
+          && !(family == 6 && model < 3 && stepping < 3));
+}
+
+/* Invokes sbrk(0) through "int $0x30". */
+static int
+int_sbrk (void)
+{
+  int retval;
+  asm volatile ("pushl $0; pushl %[number]; int $0x30; addl $8, %%esp"
+                : "=a" (retval)
+                : [number] "i" (SYS_SBRK)
+                : "ecx", "edx", "cc", "memory");
+  return retval;
+}
+
+/* Invokes sbrk(0) through SYSENTER. */
+static int
+sysenter_sbrk (void)
+{
+  int retval;
+  asm volatile ("pushl $0; pushl %[number]; "
+                "movl %%esp, %%ecx; movl $1f, %%edx; sysenter; "
+                "1: addl $8, %%esp"
+                : "=a" (retval)
+                : [number] "i" (SYS_SBRK)
+                : "ecx", "edx", "cc", "memory");
+  return retval;
+}
+
+/* Returns the fewest average cycles per call of running FUNC
+   ITERATIONS times, over ROUNDS tries. */
+static unsigned
+measure (int (*func) (void), int iterations)
+{
+  unsigned best = UINT32_MAX;
+  int round;
+
+  for (round = 0; round < ROUNDS; round++)
+    {
+      uint64_t start = rdtsc ();
+      unsigned cycles;
+      int i;
+
+      for (i = 0; i < iterations; i++)
+        func ();
+      cycles = (rdtsc () - start) / iterations;
+      if (cycles < best)
+        best = cycles;
+    }
+  return best;
+}
+
+int
+main (int argc, char *argv[])
+{
+  int iterations = argc > 1 ? atoi (argv[1]) : DEFAULT_ITERATIONS;
+  unsigned int_cycles, sysenter_cycles;
+
+  if (iterations <= 0)
+    iterations = DEFAULT_ITERATIONS;
+
+  /* Both paths must reach the same system call. */
+  if (have_sysenter () && sysenter_sbrk () != int_sbrk ())
+    {
+      printf ("syscallspeed: int $0x30 and sysenter disagree\n");
+      return EXIT_FAILURE;
+    }
+
+  int_cycles = measure (int_sbrk, iterations);
+  printf ("%-10s %8u cycles\n", "int $0x30", int_cycles);
+  if (have_sysenter ())
+    {
+      sysenter_cycles = measure (sysenter_sbrk, iterations);
+      printf ("%-10s %8u cycles (%u%% of int $0x30)\n", "sysenter",
+              sysenter_cycles,
+              int_cycles ? sysenter_cycles * 100 / int_cycles : 0);
+    }
+  else
+    printf ("%-10s not supported by this CPU\n", "sysenter");
+
+  return EXIT_SUCCESS;
+}
@@ -6,10 +6,16 @@
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
+#ifdef USERPROG
+#include "userprog/process.h"
+#endif
 
 /* Partition that contains the file system. */
 struct block *fs_device;
 
+/* Serializes access to the file system. */
+struct lock filesys_lock;
+
 static void do_format (void);
 
 /* Initializes the file system module.
@@ -17,6 +23,7 @@ static void do_format (void);
 void
 filesys_init (bool format) 
 {
+  lock_init (&filesys_lock);
   fs_device = block_get_role (BLOCK_FILESYS);
   if (fs_device == NULL)
     PANIC ("No file system device found, can't initialize file system.");
@@ -35,6 +42,9 @@ filesys_init (bool format)
 void
 filesys_done (void) 
 {
+#ifdef USERPROG
+  process_drop_images (true);
+#endif
   free_map_close ();
 }
 
@@ -87,6 +97,13 @@ filesys_remove (const char *name)
   bool success = dir != NULL && dir_remove (dir, name);
   dir_close (dir); 
 
+#ifdef USERPROG
+  /* A removed executable's blocks are freed only once the image
+     cache lets go of its inode. */
+  if (success)
+    process_drop_images (false);
+#endif
+
   return success;
 }
 
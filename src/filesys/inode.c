@@ -36,6 +36,7 @@ struct inode
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    unsigned long long generation;      /* Changes when data is written. */
     struct inode_disk data;             /* Inode content. */
   };
 
@@ -57,6 +58,9 @@ byte_to_sector (const struct inode *inode, off_t pos)
    returns the same `struct inode'. */
 static struct list open_inodes;
 
+/* Next inode generation to hand out. */
+static unsigned long long next_generation;
+
 /* Initializes the inode module. */
 void
 inode_init (void) 
@@ -137,6 +141,7 @@ inode_open (block_sector_t sector)
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
+  inode->generation = next_generation++;
   block_read (fs_device, inode->sector, &inode->data);
   return inode;
 }
@@ -194,6 +199,13 @@ inode_remove (struct inode *inode)
   inode->removed = true;
 }
 
+/* Returns true if INODE has been marked to be deleted. */
+bool
+inode_is_removed (const struct inode *inode) 
+{
+  return inode->removed;
+}
+
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
@@ -264,6 +276,8 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 
   if (inode->deny_write_cnt)
     return 0;
+  if (size > 0)
+    inode->generation = next_generation++;
 
   while (size > 0) 
     {
@@ -337,6 +351,18 @@ inode_allow_write (struct inode *inode)
   inode->deny_write_cnt--;
 }
 
+/* Returns INODE's generation, a number that no other in-memory
+   inode has ever had and that INODE keeps only until it is next
+   written.  Data derived from INODE and tagged with its
+   generation is therefore up to date as long as the tag still
+   matches, and can never be mistaken for another inode's, even
+   one that has since taken INODE's place in memory. */
+unsigned long long
+inode_generation (const struct inode *inode)
+{
+  return inode->generation;
+}
+
 /* Returns the length, in bytes, of INODE's data. */
 off_t
 inode_length (const struct inode *inode)
@@ -1,5 +1,45 @@
 #include <string.h>
 #include <debug.h>
+#include <stdint.h>
+
+/* The block primitives below move and compare data a 32-bit word
+   at a time, using the x86 string instructions "rep movsl" and
+   "rep stosl" for the bulk of the work.  A block shorter than
+   WORD_MIN_SIZE bytes is not worth the setup, so it is handled a
+   byte at a time.  Otherwise, a few leading bytes are handled
+   singly until the destination is word-aligned, then whole words
+   are moved, then the remaining 0 to 3 trailing bytes are
+   handled singly. */
+#define WORD_SIZE sizeof (uint32_t)
+#define WORD_MIN_SIZE 16
+
+/* A 32-bit word that may alias any other type, for reading
+   blocks of bytes a word at a time. */
+typedef uint32_t word_t __attribute__ ((may_alias));
+
+/* Returns the number of bytes from P up to the next word
+   boundary, in the range 0 to WORD_SIZE - 1. */
+static inline size_t
+word_head (const void *p) 
+{
+  return -(uintptr_t) p & (WORD_SIZE - 1);
+}
+
+/* Returns a word with each byte set to (unsigned char) VALUE. */
+static inline uint32_t
+word_fill (int value) 
+{
+  return (unsigned char) value * 0x01010101u;
+}
+
+/* Returns nonzero if any byte in W is 0.  Subtracting 1 from
+   each byte borrows into the byte's top bit only if the byte was
+   0 (or already had its top bit set, which ~W screens out). */
+static inline uint32_t
+word_has_zero (uint32_t w) 
+{
+  return (w - 0x01010101u) & ~w & 0x80808080u;
+}
 
 /* Copies SIZE bytes from SRC to DST, which must not overlap.
    Returns DST. */
@@ -12,6 +52,22 @@ memcpy (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
+  if (size >= WORD_MIN_SIZE) 
+    {
+      size_t head = word_head (dst);
+      size_t words;
+
+      size -= head;
+      while (head-- > 0)
+        *dst++ = *src++;
+
+      words = size / WORD_SIZE;
+      size %= WORD_SIZE;
+      asm volatile ("cld; rep movsl"
+                    : "+D" (dst), "+S" (src), "+c" (words)
+                    : : "memory");
+    }
+
   while (size-- > 0)
     *dst++ = *src++;
 
@@ -29,20 +85,43 @@ memmove (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
-  if (dst < src) 
+  if (dst <= src || dst >= src + size) 
     {
-      while (size-- > 0)
-        *dst++ = *src++;
+      /* Copying forward never overwrites a source byte before it
+         has been read, even a word at a time. */
+      return memcpy (dst_, src_, size);
     }
-  else 
+
+  /* DST overlaps the end of SRC, so copy backward. */
+  dst += size;
+  src += size;
+  if (size >= WORD_MIN_SIZE) 
     {
-      dst += size;
-      src += size;
-      while (size-- > 0)
+      size_t tail = (uintptr_t) dst & (WORD_SIZE - 1);
+      size_t words;
+
+      size -= tail;
+      while (tail-- > 0)
         *--dst = *--src;
+
+      /* With the direction flag set, "rep movsl" starts at the
+         word that ESI and EDI point to and works downward, so
+         point them at the last word and fix them up after. */
+      words = size / WORD_SIZE;
+      size %= WORD_SIZE;
+      dst -= WORD_SIZE;
+      src -= WORD_SIZE;
+      asm volatile ("std; rep movsl; cld"
+                    : "+D" (dst), "+S" (src), "+c" (words)
+                    : : "memory");
+      dst += WORD_SIZE;
+      src += WORD_SIZE;
     }
 
-  return dst;
+  while (size-- > 0)
+    *--dst = *--src;
+
+  return dst_;
 }
 
 /* Find the first differing byte in the two blocks of SIZE bytes
@@ -58,6 +137,22 @@ memcmp (const void *a_, const void *b_, size_t size)
   ASSERT (a != NULL || size == 0);
   ASSERT (b != NULL || size == 0);
 
+  /* Skip over equal words, then find the differing byte, if
+     any, in the byte loop.  x86 tolerates unaligned loads, so
+     only A is aligned. */
+  if (size >= WORD_MIN_SIZE) 
+    {
+      size_t head = word_head (a);
+
+      for (; head > 0; head--, size--, a++, b++)
+        if (*a != *b)
+          return *a > *b ? +1 : -1;
+      for (; size >= WORD_SIZE; size -= WORD_SIZE, a += WORD_SIZE,
+             b += WORD_SIZE)
+        if (*(const word_t *) a != *(const word_t *) b)
+          break;
+    }
+
   for (; size-- > 0; a++, b++)
     if (*a != *b)
       return *a > *b ? +1 : -1;
@@ -281,6 +376,23 @@ memset (void *dst_, int value, size_t size)
   unsigned char *dst = dst_;
 
   ASSERT (dst != NULL || size == 0);
+
+  if (size >= WORD_MIN_SIZE) 
+    {
+      size_t head = word_head (dst);
+      size_t words;
+
+      size -= head;
+      while (head-- > 0)
+        *dst++ = value;
+
+      words = size / WORD_SIZE;
+      size %= WORD_SIZE;
+      asm volatile ("cld; rep stosl"
+                    : "+D" (dst), "+c" (words)
+                    : "a" (word_fill (value))
+                    : "memory");
+    }
   
   while (size-- > 0)
     *dst++ = value;
@@ -296,8 +408,16 @@ strlen (const char *string)
 
   ASSERT (string != NULL);
 
-  for (p = string; *p != '\0'; p++)
-    continue;
+  /* Check bytes singly up to a word boundary, then a word at a
+     time.  An aligned word never straddles a page boundary, so
+     reading past the terminator cannot fault. */
+  for (p = string; word_head (p) != 0; p++)
+    if (*p == '\0')
+      return p - string;
+  while (!word_has_zero (*(const word_t *) p))
+    p += WORD_SIZE;
+  while (*p != '\0')
+    p++;
   return p - string;
 }
 
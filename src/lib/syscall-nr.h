@@ -1,6 +1,8 @@
 #ifndef __LIB_SYSCALL_NR_H
 #define __LIB_SYSCALL_NR_H
 
+#include <stddef.h>
+
 /* System call numbers. */
 enum 
   {
@@ -28,7 +30,102 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_FORK,                   /* Duplicate this process. */
+    SYS_MADVISE,                /* Advise on use of memory. */
+    SYS_SBRK,                   /* Change the size of the heap. */
+    SYS_MMAP_ANON,              /* Map zeroed memory. */
+    SYS_DUP,                    /* Duplicate a file descriptor. */
+    SYS_DUP2,                   /* Duplicate a file descriptor to a handle. */
+    SYS_FCNTL,                  /* Control a file descriptor. */
+    SYS_READV,                  /* Read into several buffers. */
+    SYS_WRITEV,                 /* Write from several buffers. */
+    SYS_PREAD,                  /* Read at a given offset. */
+    SYS_PWRITE,                 /* Write at a given offset. */
+    SYS_IO_SETUP,               /* Register an I/O ring. */
+    SYS_IO_ENTER,               /* Perform operations from an I/O ring. */
+    SYS_WAITANY,                /* Wait for any child process to die. */
+    SYS_PIPE,                   /* Create a pipe. */
+    SYS_SPLICE,                 /* Move data between a pipe and a file. */
+    SYS_SHM_MAP,                /* Map a shared memory segment. */
+    SYS_SHM_UNMAP,              /* Remove a shared memory mapping. */
+    SYS_THREAD_CREATE,          /* Start a thread in this process. */
+    SYS_THREAD_JOIN,            /* Wait for a thread to exit. */
+    SYS_THREAD_EXIT             /* Terminate this thread. */
+  };
+
+/* Advice for madvise(). */
+enum 
+  {
+    MADV_NORMAL,                /* No special treatment. */
+    MADV_RANDOM,                /* Expect random accesses. */
+    MADV_SEQUENTIAL,            /* Expect sequential accesses. */
+    MADV_WILLNEED,              /* Expect accesses soon. */
+    MADV_DONTNEED               /* Discard contents. */
+  };
+
+/* Commands for fcntl(). */
+enum 
+  {
+    F_GETFD,                    /* Get file descriptor flags. */
+    F_SETFD                     /* Set file descriptor flags. */
+  };
+
+/* File descriptor flags. */
+#define FD_CLOEXEC 1            /* Close on exec(). */
+
+/* A buffer for readv() and writev(). */
+struct iovec 
+  {
+    void *iov_base;             /* Start of buffer. */
+    size_t iov_len;             /* Size of buffer in bytes. */
+  };
+
+/* Operations for an I/O ring. */
+enum 
+  {
+    IORING_OP_NOP,              /* Do nothing. */
+    IORING_OP_READ,             /* Like read() or pread(). */
+    IORING_OP_WRITE,            /* Like write() or pwrite(). */
+    IORING_OP_OPEN,             /* Like open(). */
+    IORING_OP_CLOSE,            /* Like close(). */
+    IORING_OP_FSYNC             /* Flush a file to disk. */
+  };
+
+/* An I/O ring submission queue entry. */
+struct io_sqe 
+  {
+    int opcode;                 /* IORING_OP_*. */
+    int fd;                     /* File descriptor. */
+    void *addr;                 /* Buffer, or file name to open. */
+    unsigned len;               /* Size of buffer in bytes. */
+    int offset;                 /* File offset, or -1 for position. */
+    void *user_data;            /* Passed through to completion. */
+  };
+
+/* An I/O ring completion queue entry. */
+struct io_cqe 
+  {
+    void *user_data;            /* From the submission. */
+    int result;                 /* Result, as from the system call. */
+  };
+
+/* An I/O ring, in user memory.  The process fills submissions
+   at sq_tail and consumes completions at cq_head; the kernel
+   consumes submissions at sq_head and fills completions at
+   cq_tail.  Indexes run freely and are reduced modulo the number
+   of entries, which must be a power of 2. */
+struct io_ring 
+  {
+    unsigned sq_head;           /* Next submission for the kernel. */
+    unsigned sq_tail;           /* Next submission for the process. */
+    unsigned cq_head;           /* Next completion for the process. */
+    unsigned cq_tail;           /* Next completion for the kernel. */
+    unsigned entries;           /* Entries in each queue. */
+    struct io_sqe *sqes;        /* Submission queue. */
+    struct io_cqe *cqes;        /* Completion queue. */
   };
 
 #endif /* lib/syscall-nr.h */
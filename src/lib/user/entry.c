@@ -6,5 +6,6 @@ void _start (int argc, char *argv[]);
 void
 _start (int argc, char *argv[]) 
 {
+  syscall_select ();
   exit (main (argc, argv));
 }
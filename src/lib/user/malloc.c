@@ -0,0 +1,447 @@
+#include <stdlib.h>
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+
+/* A malloc() for user programs, built on sbrk().
+
+   Like the kernel's malloc() in threads/malloc.c, this rounds
+   each request up to a power of 2 and assigns it to the
+   "descriptor" that manages blocks of that size, which carves
+   its blocks out of page-sized "arenas".  A block that is too
+   big for an arena instead gets a run of whole pages, with the
+   number of pages in its arena header.
+
+   Pages come from the heap.  Freed pages go on a list of free
+   runs of pages, kept in address order and coalesced, from
+   which later requests are satisfied first-fit; only when no run
+   is big enough does the heap grow.  When a free run of at least
+   TRIM_PAGES pages reaches the top of the heap, the heap shrinks
+   to give it back to the kernel.
+
+   The threads of a process share its heap, so malloc() and
+   free() hold HEAP_LOCK while they touch it.  There are no
+   synchronization primitives in user space, so this is a
+   spinlock: a thread that finds it held spins until the holder
+   has been scheduled again and released it.  Critical sections
+   are short, and the timer preempts a spinning thread. */
+
+/* Size of a page. */
+#define PGSIZE 4096
+
+/* Minimum number of free pages at the top of the heap to give
+   back to the kernel. */
+#define TRIM_PAGES 8
+
+/* Descriptor. */
+struct desc
+  {
+    size_t block_size;          /* Size of each element in bytes. */
+    size_t blocks_per_arena;    /* Number of blocks in an arena. */
+    struct block *free_list;    /* List of free blocks. */
+  };
+
+/* Magic number for detecting arena corruption. */
+#define ARENA_MAGIC 0x9a548eed
+
+/* Arena. */
+struct arena
+  {
+    unsigned magic;             /* Always set to ARENA_MAGIC. */
+    struct desc *desc;          /* Owning descriptor, null for big block. */
+    size_t free_cnt;            /* Free blocks; pages in big block. */
+  };
+
+/* Free block. */
+struct block
+  {
+    struct block *prev;         /* Previous block in free list. */
+    struct block *next;         /* Next block in free list. */
+  };
+
+/* Free run of pages. */
+struct run
+  {
+    struct run *next;           /* Next run, at a higher address. */
+    size_t page_cnt;            /* Number of pages. */
+  };
+
+/* Our set of descriptors. */
+static struct desc descs[10];   /* Descriptors. */
+static size_t desc_cnt;         /* Number of descriptors. */
+
+/* Free runs of pages, in order of increasing address. */
+static struct run *free_runs;
+
+/* Nonzero while a thread is using the heap. */
+static volatile int heap_lock;
+
+static struct arena *block_to_arena (struct block *);
+static struct block *arena_to_block (struct arena *, size_t idx);
+
+/* Acquires HEAP_LOCK, spinning until it is free. */
+static void
+lock_heap (void)
+{
+  int was_locked;
+
+  do
+    asm volatile ("xchgl %0, %1"
+                  : "=r" (was_locked), "+m" (heap_lock)
+                  : "0" (1)
+                  : "memory");
+  while (was_locked);
+}
+
+/* Releases HEAP_LOCK. */
+static void
+unlock_heap (void)
+{
+  asm volatile ("" : : : "memory");
+  heap_lock = 0;
+}
+
+/* Initializes the descriptors. */
+static void
+init_descs (void)
+{
+  size_t block_size;
+
+  for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2)
+    {
+      struct desc *d = &descs[desc_cnt++];
+      ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
+      d->block_size = block_size;
+      d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
+      d->free_list = NULL;
+    }
+}
+
+/* Returns the address just past the end of run R. */
+static uint8_t *
+run_end (struct run *r)
+{
+  return (uint8_t *) r + r->page_cnt * PGSIZE;
+}
+
+/* Obtains and returns PAGE_CNT contiguous pages, from the free
+   runs if possible, otherwise by growing the heap.  Returns a
+   null pointer if memory is not available. */
+static void *
+get_pages (size_t page_cnt)
+{
+  struct run **rp, *r;
+  uint8_t *brk;
+  size_t pad;
+
+  for (rp = &free_runs; (r = *rp) != NULL; rp = &r->next)
+    if (r->page_cnt >= page_cnt)
+      {
+        if (r->page_cnt > page_cnt)
+          {
+            struct run *rest = (struct run *) ((uint8_t *) r
+                                               + page_cnt * PGSIZE);
+            rest->next = r->next;
+            rest->page_cnt = r->page_cnt - page_cnt;
+            *rp = rest;
+          }
+        else
+          *rp = r->next;
+        return r;
+      }
+
+  /* Grow the heap, first padding the break out to a page
+     boundary if necessary. */
+  brk = sbrk (0);
+  if (brk == (void *) -1)
+    return NULL;
+  pad = ROUND_UP ((uintptr_t) brk, PGSIZE) - (uintptr_t) brk;
+  if (page_cnt > (INTPTR_MAX - pad) / PGSIZE
+      || sbrk (pad + page_cnt * PGSIZE) == (void *) -1)
+    return NULL;
+  return brk + pad;
+}
+
+/* Frees the PAGE_CNT pages at PAGES, which must have been
+   obtained with get_pages(). */
+static void
+free_pages (void *pages, size_t page_cnt)
+{
+  struct run *r = pages;
+  struct run *prev = NULL;
+  struct run **rp;
+
+  /* Insert R into the free list, in order. */
+  for (rp = &free_runs; *rp != NULL && *rp < r; rp = &(*rp)->next)
+    prev = *rp;
+  r->next = *rp;
+  r->page_cnt = page_cnt;
+  *rp = r;
+
+  /* Coalesce R with the following run, then with the preceding
+     run. */
+  if (r->next != NULL && run_end (r) == (uint8_t *) r->next)
+    {
+      r->page_cnt += r->next->page_cnt;
+      r->next = r->next->next;
+    }
+  if (prev != NULL && run_end (prev) == (uint8_t *) r)
+    {
+      prev->page_cnt += r->page_cnt;
+      prev->next = r->next;
+      r = prev;
+    }
+
+  /* Give a big enough run at the top of the heap back to the
+     kernel. */
+  if (r->next == NULL && r->page_cnt >= TRIM_PAGES
+      && run_end (r) == sbrk (0))
+    {
+      for (rp = &free_runs; *rp != r; rp = &(*rp)->next)
+        continue;
+      if (sbrk (-(intptr_t) (r->page_cnt * PGSIZE)) != (void *) -1)
+        *rp = NULL;
+    }
+}
+
+/* Adds block B to the front of descriptor D's free list. */
+static void
+push_free (struct desc *d, struct block *b)
+{
+  b->prev = NULL;
+  b->next = d->free_list;
+  if (b->next != NULL)
+    b->next->prev = b;
+  d->free_list = b;
+}
+
+/* Removes block B from descriptor D's free list. */
+static void
+remove_free (struct desc *d, struct block *b)
+{
+  if (b->prev != NULL)
+    b->prev->next = b->next;
+  else
+    d->free_list = b->next;
+  if (b->next != NULL)
+    b->next->prev = b->prev;
+}
+
+/* Obtains and returns a new block of at least SIZE bytes, which
+   must not be 0.  Returns a null pointer if memory is not
+   available.  The caller must hold HEAP_LOCK. */
+static void *
+alloc_block (size_t size)
+{
+  struct desc *d;
+  struct block *b;
+  struct arena *a;
+
+  if (desc_cnt == 0)
+    init_descs ();
+
+  /* Find the smallest descriptor that satisfies a SIZE-byte
+     request. */
+  for (d = descs; d < descs + desc_cnt; d++)
+    if (d->block_size >= size)
+      break;
+  if (d == descs + desc_cnt)
+    {
+      /* SIZE is too big for any descriptor.
+         Allocate enough pages to hold SIZE plus an arena. */
+      size_t page_cnt;
+
+      if (size > SIZE_MAX - sizeof *a - PGSIZE)
+        return NULL;
+      page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
+      a = get_pages (page_cnt);
+      if (a == NULL)
+        return NULL;
+
+      /* Initialize the arena to indicate a big block of PAGE_CNT
+         pages, and return it. */
+      a->magic = ARENA_MAGIC;
+      a->desc = NULL;
+      a->free_cnt = page_cnt;
+      return a + 1;
+    }
+
+  /* If the free list is empty, create a new arena. */
+  if (d->free_list == NULL)
+    {
+      size_t i;
+
+      /* Allocate a page. */
+      a = get_pages (1);
+      if (a == NULL)
+        return NULL;
+
+      /* Initialize arena and add its blocks to the free list. */
+      a->magic = ARENA_MAGIC;
+      a->desc = d;
+      a->free_cnt = d->blocks_per_arena;
+      for (i = d->blocks_per_arena; i-- > 0; )
+        push_free (d, arena_to_block (a, i));
+    }
+
+  /* Get a block from free list and return it. */
+  b = d->free_list;
+  remove_free (d, b);
+  a = block_to_arena (b);
+  a->free_cnt--;
+  return b;
+}
+
+/* Obtains and returns a new block of at least SIZE bytes.
+   Returns a null pointer if memory is not available. */
+void *
+malloc (size_t size)
+{
+  void *p;
+
+  /* A null pointer satisfies a request for 0 bytes. */
+  if (size == 0)
+    return NULL;
+
+  lock_heap ();
+  p = alloc_block (size);
+  unlock_heap ();
+  return p;
+}
+
+/* Allocates and return A times B bytes initialized to zeroes.
+   Returns a null pointer if memory is not available. */
+void *
+calloc (size_t a, size_t b)
+{
+  void *p;
+  size_t size;
+
+  /* Calculate block size and make sure it fits in size_t. */
+  if (b != 0 && a > SIZE_MAX / b)
+    return NULL;
+  size = a * b;
+
+  /* Allocate and zero memory. */
+  p = malloc (size);
+  if (p != NULL)
+    memset (p, 0, size);
+
+  return p;
+}
+
+/* Returns the number of bytes allocated for BLOCK. */
+static size_t
+block_size (void *block)
+{
+  struct block *b = block;
+  struct arena *a = block_to_arena (b);
+  struct desc *d = a->desc;
+
+  return d != NULL ? d->block_size : PGSIZE * a->free_cnt - sizeof *a;
+}
+
+/* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
+   moving it in the process.
+   If successful, returns the new block; on failure, returns a
+   null pointer.
+   A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
+   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK).
+   A block that is already big enough stays where it is. */
+void *
+realloc (void *old_block, size_t new_size)
+{
+  if (new_size == 0)
+    {
+      free (old_block);
+      return NULL;
+    }
+  else if (old_block != NULL && new_size <= block_size (old_block))
+    return old_block;
+  else
+    {
+      void *new_block = malloc (new_size);
+      if (old_block != NULL && new_block != NULL)
+        {
+          memcpy (new_block, old_block, block_size (old_block));
+          free (old_block);
+        }
+      return new_block;
+    }
+}
+
+/* Frees block P, which must have been previously allocated with
+   malloc(), calloc(), or realloc(). */
+void
+free (void *p)
+{
+  if (p != NULL)
+    {
+      struct block *b = p;
+      struct arena *a = block_to_arena (b);
+      struct desc *d = a->desc;
+
+      lock_heap ();
+      if (d != NULL)
+        {
+          /* It's a normal block.  We handle it here. */
+
+#ifndef NDEBUG
+          /* Clear the block to help detect use-after-free bugs. */
+          memset (b, 0xcc, d->block_size);
+#endif
+
+          /* Add block to free list. */
+          push_free (d, b);
+
+          /* If the arena is now entirely unused, free it. */
+          if (++a->free_cnt >= d->blocks_per_arena)
+            {
+              size_t i;
+
+              ASSERT (a->free_cnt == d->blocks_per_arena);
+              for (i = 0; i < d->blocks_per_arena; i++)
+                remove_free (d, arena_to_block (a, i));
+              free_pages (a, 1);
+            }
+        }
+      else
+        {
+          /* It's a big block.  Free its pages. */
+          free_pages (a, a->free_cnt);
+        }
+      unlock_heap ();
+    }
+}
+
+/* Returns the arena that block B is inside. */
+static struct arena *
+block_to_arena (struct block *b)
+{
+  struct arena *a = (struct arena *) ((uintptr_t) b & ~(PGSIZE - 1));
+
+  /* Check that the arena is valid. */
+  ASSERT (a != NULL);
+  ASSERT (a->magic == ARENA_MAGIC);
+
+  /* Check that the block is properly aligned for the arena. */
+  ASSERT (a->desc == NULL
+          || ((uintptr_t) b % PGSIZE - sizeof *a) % a->desc->block_size == 0);
+  ASSERT (a->desc != NULL || (uintptr_t) b % PGSIZE == sizeof *a);
+
+  return a;
+}
+
+/* Returns the (IDX - 1)'th block within arena A. */
+static struct block *
+arena_to_block (struct arena *a, size_t idx)
+{
+  ASSERT (a != NULL);
+  ASSERT (a->magic == ARENA_MAGIC);
+  ASSERT (idx < a->desc->blocks_per_arena);
+  return (struct block *) ((uint8_t *) a
+                           + sizeof *a
+                           + idx * a->desc->block_size);
+}
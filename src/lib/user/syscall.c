@@ -1,31 +1,51 @@
 #include <syscall.h>
 #include "../syscall-nr.h"
 
+/* True if system calls enter the kernel with SYSENTER, false if
+   they use "int $0x30".  Set by syscall_select(). */
+static bool use_sysenter;
+
+/* Enters the kernel, with the system call number and arguments
+   already pushed on the stack.  SYSENTER saves neither the return
+   address nor the stack pointer, so we pass them in EDX and ECX,
+   where the kernel's SYSEXIT takes them back from.  It returns
+   to label 1, skipping the "int $0x30" used otherwise. */
+#define SYSCALL_TRAP                                            \
+        "cmpb $0, %[fast]; je 2f; "                             \
+        "movl %%esp, %%ecx; movl $1f, %%edx; sysenter; "        \
+        "2: int $0x30; 1: "
+
+/* Registers and memory changed by a system call. */
+#define SYSCALL_CLOBBERS "ecx", "edx", "cc", "memory"
+
 /* Invokes syscall NUMBER, passing no arguments, and returns the
    return value as an `int'. */
 #define syscall0(NUMBER)                                        \
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
-            ("pushl %[number]; int $0x30; addl $4, %%esp"       \
+            ("pushl %[number]; " SYSCALL_TRAP "addl $4, %%esp"  \
                : "=a" (retval)                                  \
-               : [number] "i" (NUMBER)                          \
-               : "memory");                                     \
+               : [number] "i" (NUMBER),                         \
+                 [fast] "m" (use_sysenter)                      \
+               : SYSCALL_CLOBBERS);                             \
           retval;                                               \
         })
 
 /* Invokes syscall NUMBER, passing argument ARG0, and returns the
    return value as an `int'. */
-#define syscall1(NUMBER, ARG0)                                           \
-        ({                                                               \
-          int retval;                                                    \
-          asm volatile                                                   \
-            ("pushl %[arg0]; pushl %[number]; int $0x30; addl $8, %%esp" \
-               : "=a" (retval)                                           \
-               : [number] "i" (NUMBER),                                  \
-                 [arg0] "g" (ARG0)                                       \
-               : "memory");                                              \
-          retval;                                                        \
+#define syscall1(NUMBER, ARG0)                                  \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg0]; pushl %[number]; "                 \
+             SYSCALL_TRAP "addl $8, %%esp"                      \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "g" (ARG0),                             \
+                 [fast] "m" (use_sysenter)                      \
+               : SYSCALL_CLOBBERS);                             \
+          retval;                                               \
         })
 
 /* Invokes syscall NUMBER, passing arguments ARG0 and ARG1, and
@@ -35,12 +55,13 @@
           int retval;                                           \
           asm volatile                                          \
             ("pushl %[arg1]; pushl %[arg0]; "                   \
-             "pushl %[number]; int $0x30; addl $12, %%esp"      \
+             "pushl %[number]; " SYSCALL_TRAP "addl $12, %%esp" \
                : "=a" (retval)                                  \
                : [number] "i" (NUMBER),                         \
                  [arg0] "r" (ARG0),                             \
-                 [arg1] "r" (ARG1)                              \
-               : "memory");                                     \
+                 [arg1] "r" (ARG1),                             \
+                 [fast] "m" (use_sysenter)                      \
+               : SYSCALL_CLOBBERS);                             \
           retval;                                               \
         })
 
@@ -51,16 +72,55 @@
           int retval;                                           \
           asm volatile                                          \
             ("pushl %[arg2]; pushl %[arg1]; pushl %[arg0]; "    \
-             "pushl %[number]; int $0x30; addl $16, %%esp"      \
+             "pushl %[number]; " SYSCALL_TRAP "addl $16, %%esp" \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "r" (ARG0),                             \
+                 [arg1] "r" (ARG1),                             \
+                 [arg2] "r" (ARG2),                             \
+                 [fast] "m" (use_sysenter)                      \
+               : SYSCALL_CLOBBERS);                             \
+          retval;                                               \
+        })
+
+/* Invokes syscall NUMBER, passing arguments ARG0, ARG1, ARG2,
+   and ARG3, and returns the return value as an `int'. */
+#define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)                \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg3]; pushl %[arg2]; pushl %[arg1]; "    \
+             "pushl %[arg0]; pushl %[number]; "                 \
+             SYSCALL_TRAP "addl $20, %%esp"                     \
                : "=a" (retval)                                  \
                : [number] "i" (NUMBER),                         \
                  [arg0] "r" (ARG0),                             \
                  [arg1] "r" (ARG1),                             \
-                 [arg2] "r" (ARG2)                              \
-               : "memory");                                     \
+                 [arg2] "r" (ARG2),                             \
+                 [arg3] "g" (ARG3),                             \
+                 [fast] "m" (use_sysenter)                      \
+               : SYSCALL_CLOBBERS);                             \
           retval;                                               \
         })
 
+/* Chooses SYSENTER for system calls if the CPU supports it.
+   The kernel accepts SYSENTER under the same condition.  The
+   earliest Pentium Pro steppings report the feature without
+   implementing it. */
+void
+syscall_select (void)
+{
+  uint32_t eax, ebx, ecx, edx;
+  unsigned family, model, stepping;
+
+  asm ("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (1));
+  family = (eax >> 8) & 0xf;
+  model = (eax >> 4) & 0xf;
+  stepping = eax & 0xf;
+  use_sysenter = ((edx & (1u << 11)) != 0
+                  && !(family == 6 && model < 3 && stepping < 3));
+}
+
 void
 halt (void) 
 {
@@ -182,3 +242,139 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+pid_t
+fork (void)
+{
+  return (pid_t) syscall0 (SYS_FORK);
+}
+
+int
+madvise (void *addr, size_t length, int advice)
+{
+  return syscall3 (SYS_MADVISE, addr, length, advice);
+}
+
+void *
+sbrk (intptr_t increment)
+{
+  return (void *) syscall1 (SYS_SBRK, increment);
+}
+
+mapid_t
+mmap_anon (void *addr, size_t length)
+{
+  return syscall2 (SYS_MMAP_ANON, addr, length);
+}
+
+int
+dup (int fd)
+{
+  return syscall1 (SYS_DUP, fd);
+}
+
+int
+dup2 (int fd, int new_fd)
+{
+  return syscall2 (SYS_DUP2, fd, new_fd);
+}
+
+int
+fcntl (int fd, int cmd, int arg)
+{
+  return syscall3 (SYS_FCNTL, fd, cmd, arg);
+}
+
+int
+readv (int fd, const struct iovec *iov, int iovcnt)
+{
+  return syscall3 (SYS_READV, fd, iov, iovcnt);
+}
+
+int
+writev (int fd, const struct iovec *iov, int iovcnt)
+{
+  return syscall3 (SYS_WRITEV, fd, iov, iovcnt);
+}
+
+int
+pread (int fd, void *buffer, unsigned length, int offset)
+{
+  return syscall4 (SYS_PREAD, fd, buffer, length, offset);
+}
+
+int
+pwrite (int fd, const void *buffer, unsigned length, int offset)
+{
+  return syscall4 (SYS_PWRITE, fd, buffer, length, offset);
+}
+
+int
+io_setup (struct io_ring *ring)
+{
+  return syscall1 (SYS_IO_SETUP, ring);
+}
+
+int
+io_enter (unsigned to_submit)
+{
+  return syscall1 (SYS_IO_ENTER, to_submit);
+}
+
+pid_t
+waitany (int *status)
+{
+  return syscall1 (SYS_WAITANY, status);
+}
+
+int
+pipe (int fds[2])
+{
+  return syscall1 (SYS_PIPE, fds);
+}
+
+int
+splice (int fd_in, int fd_out, unsigned length)
+{
+  return syscall3 (SYS_SPLICE, fd_in, fd_out, length);
+}
+
+mapid_t
+shm_map (const char *name, size_t size, void *addr)
+{
+  return syscall3 (SYS_SHM_MAP, name, size, addr);
+}
+
+int
+shm_unmap (void *addr)
+{
+  return syscall1 (SYS_SHM_UNMAP, addr);
+}
+
+/* Where a thread from thread_create() starts running, as if
+   called with FUNC and AUX.  Returning from FUNC ends the thread
+   with FUNC's return value as its exit status. */
+static void
+thread_start (int (*func) (void *), void *aux)
+{
+  thread_exit (func (aux));
+}
+
+tid_t
+thread_create (int (*func) (void *), void *aux)
+{
+  return syscall3 (SYS_THREAD_CREATE, thread_start, func, aux);
+}
+
+int
+thread_join (tid_t tid)
+{
+  return syscall1 (SYS_THREAD_JOIN, tid);
+}
+
+void
+thread_exit (int status)
+{
+  syscall1 (SYS_THREAD_EXIT, status);
+  NOT_REACHED ();
+}
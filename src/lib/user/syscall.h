@@ -2,12 +2,19 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <debug.h>
+#include <syscall-nr.h>
 
 /* Process identifier. */
 typedef int pid_t;
 #define PID_ERROR ((pid_t) -1)
 
+/* Thread identifier. */
+typedef int tid_t;
+#define TID_ERROR ((tid_t) -1)
+
 /* Map region identifier. */
 typedef int mapid_t;
 #define MAP_FAILED ((mapid_t) -1)
@@ -15,6 +22,9 @@ typedef int mapid_t;
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
+/* Called by _start() before main(). */
+void syscall_select (void);
+
 /* Typical return values from main() and arguments to exit(). */
 #define EXIT_SUCCESS 0          /* Successful execution. */
 #define EXIT_FAILURE 1          /* Unsuccessful execution. */
@@ -45,4 +55,27 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+pid_t fork (void);
+int madvise (void *addr, size_t length, int advice);
+void *sbrk (intptr_t increment);
+mapid_t mmap_anon (void *addr, size_t length);
+int dup (int fd);
+int dup2 (int fd, int new_fd);
+int fcntl (int fd, int cmd, int arg);
+int readv (int fd, const struct iovec *, int iovcnt);
+int writev (int fd, const struct iovec *, int iovcnt);
+int pread (int fd, void *buffer, unsigned length, int offset);
+int pwrite (int fd, const void *buffer, unsigned length, int offset);
+int io_setup (struct io_ring *);
+int io_enter (unsigned to_submit);
+pid_t waitany (int *status);
+int pipe (int fds[2]);
+int splice (int fd_in, int fd_out, unsigned length);
+mapid_t shm_map (const char *name, size_t size, void *addr);
+int shm_unmap (void *addr);
+tid_t thread_create (int (*func) (void *), void *aux);
+int thread_join (tid_t);
+void thread_exit (int status) NO_RETURN;
+
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,50 @@
+/* Duplicates a file descriptor with dup() and dup2(), checking
+   that the duplicates share the file position and outlive the
+   original, that new handles are the lowest ones free, even
+   after the table of handles has had to grow, and that the
+   close-on-exec flag can be set and read back. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define DUP_CNT 200
+
+void
+test_main (void) 
+{
+  char buf[10];
+  int handle, dup_handle;
+  int i;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((dup_handle = dup (handle)) == handle + 1, "dup");
+  CHECK (read (handle, buf, sizeof buf) == sizeof buf,
+         "read %zu bytes", sizeof buf);
+  CHECK (tell (dup_handle) == sizeof buf, "tell duplicate");
+
+  CHECK (dup2 (dup_handle, 100) == 100, "dup2 to 100");
+  CHECK (fcntl (100, F_GETFD, 0) == 0, "get flags");
+  CHECK (fcntl (100, F_SETFD, FD_CLOEXEC) == 0, "set close-on-exec");
+  CHECK (fcntl (100, F_GETFD, 0) == FD_CLOEXEC, "get close-on-exec");
+
+  msg ("dup %d times", DUP_CNT);
+  for (i = 0; i < DUP_CNT; i++)
+    {
+      int expected = dup_handle + 1 + i + (dup_handle + 1 + i >= 100);
+      int retval = dup (handle);
+      if (retval != expected)
+        fail ("dup returned %d instead of %d", retval, expected);
+    }
+  for (i = 0; i < DUP_CNT; i++)
+    close (dup_handle + 1 + i + (dup_handle + 1 + i >= 100));
+
+  msg ("close original handles");
+  close (handle);
+  close (dup_handle);
+  CHECK (dup (100) == handle, "dup reuses lowest free handle");
+
+  seek (100, 0);
+  check_file_handle (100, "sample.txt", sample, sizeof sample - 1);
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(dup) begin
+(dup) open "sample.txt"
+(dup) dup
+(dup) read 10 bytes
+(dup) tell duplicate
+(dup) dup2 to 100
+(dup) get flags
+(dup) set close-on-exec
+(dup) get close-on-exec
+(dup) dup 200 times
+(dup) close original handles
+(dup) dup reuses lowest free handle
+(dup) verified contents of "sample.txt"
+(dup) end
+dup: exit(0)
+EOF
+pass;
@@ -0,0 +1,76 @@
+/* Opens, writes, reads back, and closes a file through an I/O
+   ring, submitting several operations with each io_enter()
+   call, and checks the completions. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ENTRIES 8
+
+static struct io_sqe sqes[ENTRIES];
+static struct io_cqe cqes[ENTRIES];
+static struct io_ring ring = {0, 0, 0, 0, ENTRIES, sqes, cqes};
+
+/* Adds a submission to the ring. */
+static void
+submit (int opcode, int fd, void *addr, unsigned len, int offset,
+        int user_data)
+{
+  struct io_sqe *sqe = &sqes[ring.sq_tail++ % ENTRIES];
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->addr = addr;
+  sqe->len = len;
+  sqe->offset = offset;
+  sqe->user_data = (void *) user_data;
+}
+
+/* Takes the next completion from the ring, checks that it is for
+   the submission tagged USER_DATA, and returns its result. */
+static int
+complete (int user_data)
+{
+  struct io_cqe *cqe;
+
+  if (ring.cq_head == ring.cq_tail)
+    fail ("no completion for submission %d", user_data);
+  cqe = &cqes[ring.cq_head++ % ENTRIES];
+  if (cqe->user_data != (void *) user_data)
+    fail ("completion for submission %d, expected %d",
+          (int) cqe->user_data, user_data);
+  return cqe->result;
+}
+
+void
+test_main (void) 
+{
+  static char one[] = "ring ", two[] = "buffer";
+  char buf[11];
+  int handle;
+
+  CHECK (create ("ring.txt", 16), "create \"ring.txt\"");
+  CHECK (io_setup (&ring) == 0, "io_setup");
+
+  submit (IORING_OP_OPEN, 0, "ring.txt", 0, 0, 1);
+  CHECK (io_enter (1) == 1, "submit open");
+  CHECK ((handle = complete (1)) > 1, "open completed");
+
+  submit (IORING_OP_WRITE, handle, one, strlen (one), -1, 2);
+  submit (IORING_OP_WRITE, handle, two, strlen (two), -1, 3);
+  submit (IORING_OP_FSYNC, handle, NULL, 0, 0, 4);
+  submit (IORING_OP_READ, handle, buf, sizeof buf, 0, 5);
+  submit (IORING_OP_READ, 1234, buf, sizeof buf, 0, 6);
+  submit (IORING_OP_CLOSE, handle, NULL, 0, 0, 7);
+  CHECK (io_enter (ENTRIES) == 6, "submit 6 operations");
+  CHECK (complete (2) == 5, "first write completed");
+  CHECK (complete (3) == 6, "second write completed");
+  CHECK (complete (4) == 0, "fsync completed");
+  CHECK (complete (5) == sizeof buf, "read completed");
+  CHECK (complete (6) == -1, "read from bad handle failed");
+  CHECK (complete (7) == 0, "close completed");
+  if (memcmp (buf, "ring buffer", sizeof buf))
+    fail ("read wrong data");
+  CHECK (ring.sq_head == ring.sq_tail, "submission queue empty");
+}
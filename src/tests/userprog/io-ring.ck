@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(io-ring) begin
+(io-ring) create "ring.txt"
+(io-ring) io_setup
+(io-ring) submit open
+(io-ring) open completed
+(io-ring) submit 6 operations
+(io-ring) first write completed
+(io-ring) second write completed
+(io-ring) fsync completed
+(io-ring) read completed
+(io-ring) read from bad handle failed
+(io-ring) close completed
+(io-ring) submission queue empty
+(io-ring) end
+io-ring: exit(0)
+EOF
+pass;
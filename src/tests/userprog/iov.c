@@ -0,0 +1,46 @@
+/* Writes a file with writev() and pwrite() and reads it back
+   with readv() and pread(), checking that the vectored calls
+   advance the file position and the positional calls leave it
+   alone. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  static char one[] = "Hello, ", two[] = "vectored ", three[] = "world";
+  struct iovec iov[3];
+  char a[9], b[12], c[8];
+  int handle;
+
+  CHECK (create ("iov.txt", 32), "create \"iov.txt\"");
+  CHECK ((handle = open ("iov.txt")) > 1, "open \"iov.txt\"");
+
+  iov[0].iov_base = one;
+  iov[0].iov_len = strlen (one);
+  iov[1].iov_base = two;
+  iov[1].iov_len = strlen (two);
+  iov[2].iov_base = three;
+  iov[2].iov_len = strlen (three);
+  CHECK (writev (handle, iov, 3) == 21, "writev 21 bytes");
+  CHECK (tell (handle) == 21, "tell after writev");
+
+  CHECK (pwrite (handle, "V", 1, 7) == 1, "pwrite at offset 7");
+  CHECK (pread (handle, c, 8, 7) == 8, "pread at offset 7");
+  if (memcmp (c, "Vectored", 8))
+    fail ("pread read wrong data");
+  CHECK (tell (handle) == 21, "tell after pread and pwrite");
+
+  seek (handle, 0);
+  iov[0].iov_base = a;
+  iov[0].iov_len = sizeof a;
+  iov[1].iov_base = b;
+  iov[1].iov_len = sizeof b;
+  CHECK (readv (handle, iov, 2) == 21, "readv 21 bytes");
+  if (memcmp (a, "Hello, Ve", sizeof a) || memcmp (b, "ctored world", sizeof b))
+    fail ("readv read wrong data");
+  CHECK (tell (handle) == 21, "tell after readv");
+}
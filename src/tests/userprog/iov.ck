@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(iov) begin
+(iov) create "iov.txt"
+(iov) open "iov.txt"
+(iov) writev 21 bytes
+(iov) tell after writev
+(iov) pwrite at offset 7
+(iov) pread at offset 7
+(iov) tell after pread and pwrite
+(iov) readv 21 bytes
+(iov) tell after readv
+(iov) end
+iov: exit(0)
+EOF
+pass;
@@ -0,0 +1,60 @@
+/* Moves data through a pipe with read() and write(), across the
+   end of its ring buffer, checks end of file and writing with
+   no reader, and splices sample.txt through a pipe into another
+   file. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[3000];
+static char copy[sizeof buf];
+
+void
+test_main (void) 
+{
+  int fds[2];
+  int in, out;
+  size_t i;
+  int round;
+
+  CHECK (pipe (fds) == 0, "pipe");
+
+  for (round = 0; round < 2; round++)
+    {
+      for (i = 0; i < sizeof buf; i++)
+        buf[i] = 'a' + (i + round) % 26;
+      CHECK (write (fds[1], buf, sizeof buf) == (int) sizeof buf,
+             "write %zu bytes", sizeof buf);
+      CHECK (read (fds[0], copy, sizeof copy) == (int) sizeof copy,
+             "read %zu bytes", sizeof copy);
+      compare_bytes (copy, buf, sizeof buf, 0, "pipe");
+    }
+
+  msg ("close write end");
+  close (fds[1]);
+  CHECK (read (fds[0], copy, sizeof copy) == 0, "read at end of file");
+  msg ("close read end");
+  close (fds[0]);
+
+  CHECK (pipe (fds) == 0, "pipe");
+  msg ("close read end");
+  close (fds[0]);
+  CHECK (write (fds[1], buf, 1) == -1, "write with no reader");
+  msg ("close write end");
+  close (fds[1]);
+
+  CHECK (pipe (fds) == 0, "pipe");
+  CHECK (create ("spliced.txt", sizeof sample - 1), "create \"spliced.txt\"");
+  CHECK ((in = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((out = open ("spliced.txt")) > 1, "open \"spliced.txt\"");
+  CHECK (splice (in, fds[1], sizeof sample) == sizeof sample - 1,
+         "splice sample.txt into pipe");
+  CHECK (splice (fds[0], out, sizeof sample) == sizeof sample - 1,
+         "splice pipe into spliced.txt");
+  close (in);
+  close (out);
+  check_file ("spliced.txt", sample, sizeof sample - 1);
+}
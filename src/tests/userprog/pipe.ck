@@ -0,0 +1,31 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe) begin
+(pipe) pipe
+(pipe) write 3000 bytes
+(pipe) read 3000 bytes
+(pipe) write 3000 bytes
+(pipe) read 3000 bytes
+(pipe) close write end
+(pipe) read at end of file
+(pipe) close read end
+(pipe) pipe
+(pipe) close read end
+(pipe) write with no reader
+(pipe) close write end
+(pipe) pipe
+(pipe) create "spliced.txt"
+(pipe) open "sample.txt"
+(pipe) open "spliced.txt"
+(pipe) splice sample.txt into pipe
+(pipe) splice pipe into spliced.txt
+(pipe) open "spliced.txt" for verification
+(pipe) verified contents of "spliced.txt"
+(pipe) close "spliced.txt"
+(pipe) end
+pipe: exit(0)
+EOF
+pass;
@@ -0,0 +1,26 @@
+/* Waits for children with waitany(), which must return each
+   child's pid and exit status, and -1 once no children are left
+   to wait for, including children already reaped by wait(). */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  pid_t child, pid;
+  int status = 0;
+
+  CHECK (waitany (&status) == -1, "waitany() with no children");
+
+  CHECK ((child = exec ("child-simple")) != -1, "exec \"child-simple\"");
+  pid = waitany (&status);
+  if (pid != child)
+    fail ("waitany() returned %d instead of %d", pid, child);
+  msg ("waitany() status = %d", status);
+
+  CHECK ((child = exec ("child-simple")) != -1, "exec \"child-simple\"");
+  msg ("wait(exec()) = %d", wait (child));
+  CHECK (waitany (&status) == -1, "waitany() with no children left");
+}
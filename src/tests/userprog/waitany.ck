@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(waitany) begin
+(waitany) waitany() with no children
+(waitany) exec "child-simple"
+(child-simple) run
+child-simple: exit(81)
+(waitany) waitany() status = 81
+(waitany) exec "child-simple"
+(child-simple) run
+child-simple: exit(81)
+(waitany) wait(exec()) = 81
+(waitany) waitany() with no children left
+(waitany) end
+waitany: exit(0)
+EOF
+pass;
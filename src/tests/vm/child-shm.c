@@ -0,0 +1,19 @@
+/* Child process for shm-share test.
+   Maps the parent's shared memory segment by name, checks the
+   parent's write to it, and writes a reply. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char *shm = (char *) 0x10000000;
+
+  CHECK (shm_map ("shm-share", 2 * 4096, shm) != MAP_FAILED,
+         "shm_map \"shm-share\"");
+  CHECK (!strcmp (shm, "hello, child"), "check parent's write");
+  strlcpy (shm + 4096, "hello, parent", 4096);
+}
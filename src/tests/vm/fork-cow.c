@@ -0,0 +1,85 @@
+/* Forks children that share the parent's memory copy-on-write
+   and checks that each side's writes stay its own: to a page in
+   memory, and to pages of a buffer too big to stay in memory,
+   which are in swap, shared by both, when each side writes them.
+   Also checks that a child can use the file handles it inherits
+   from its parent. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define SIZE (2 * 1024 * 1024)
+
+static char page[PAGE_SIZE];
+static char big[SIZE];
+
+/* Returns the original value of byte I of BIG. */
+static char
+pattern (size_t i)
+{
+  return (i * 7 + i / PAGE_SIZE) & 0xff;
+}
+
+/* Writes VALUE into the first byte of each page of BIG, then
+   checks that it is there and that every other byte still has
+   its original value. */
+static void
+write_big (char value)
+{
+  size_t i;
+
+  for (i = 0; i < SIZE; i += PAGE_SIZE)
+    big[i] = value;
+  for (i = 0; i < SIZE; i++)
+    if (big[i] != (i % PAGE_SIZE == 0 ? value : pattern (i)))
+      fail ("byte %zu of buffer is %d", i, big[i]);
+}
+
+void
+test_main (void)
+{
+  char buf[sizeof sample - 1];
+  pid_t child;
+  int handle;
+  size_t i;
+
+  memset (page, 'p', sizeof page);
+  child = fork ();
+  if (child == 0)
+    {
+      memset (page, 'c', sizeof page);
+      exit (page[0] == 'c' && page[PAGE_SIZE - 1] == 'c' ? 11 : 1);
+    }
+  CHECK (child != -1 && wait (child) == 11, "fork child to write a page");
+  for (i = 0; i < sizeof page; i++)
+    if (page[i] != 'p')
+      fail ("child's write changed byte %zu of parent's page", i);
+  msg ("parent's page unchanged");
+
+  msg ("fill buffer");
+  for (i = 0; i < SIZE; i++)
+    big[i] = pattern (i);
+  child = fork ();
+  if (child == 0)
+    {
+      write_big ('c');
+      exit (12);
+    }
+  CHECK (child != -1 && wait (child) == 12,
+         "fork child to write swapped pages");
+  msg ("write swapped pages in parent");
+  write_big ('p');
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  child = fork ();
+  if (child == 0)
+    exit (read (handle, buf, sizeof buf) == (int) sizeof buf
+          && !memcmp (buf, sample, sizeof buf) ? 13 : 1);
+  CHECK (child != -1 && wait (child) == 13,
+         "fork child to read inherited handle");
+  close (handle);
+}
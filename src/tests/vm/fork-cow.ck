@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fork-cow) begin
+fork-cow: exit(11)
+(fork-cow) fork child to write a page
+(fork-cow) parent's page unchanged
+(fork-cow) fill buffer
+fork-cow: exit(12)
+(fork-cow) fork child to write swapped pages
+(fork-cow) write swapped pages in parent
+(fork-cow) open "sample.txt"
+fork-cow: exit(13)
+(fork-cow) fork child to read inherited handle
+(fork-cow) end
+fork-cow: exit(0)
+EOF
+pass;
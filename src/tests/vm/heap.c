@@ -0,0 +1,93 @@
+/* Grows and shrinks the heap with sbrk(), maps anonymous memory,
+   and exercises malloc(), realloc(), and free() in lib/user,
+   checking that freeing everything shrinks the heap again. */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/arc4.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BLOCK_CNT 256
+
+static char *blocks[BLOCK_CNT];
+static size_t sizes[BLOCK_CNT];
+
+/* Fills block I with a pattern based on I. */
+static void
+fill (size_t i)
+{
+  memset (blocks[i], i & 0xff, sizes[i]);
+}
+
+/* Checks that block I still holds its pattern. */
+static void
+verify (size_t i)
+{
+  size_t j;
+
+  for (j = 0; j < sizes[i]; j++)
+    if ((uint8_t) blocks[i][j] != (i & 0xff))
+      fail ("byte %zu of block %zu corrupted", j, i);
+}
+
+void
+test_main (void)
+{
+  char *anon = (char *) 0x10000000;
+  struct arc4 arc4;
+  char *brk, *p;
+  mapid_t map;
+  size_t i;
+
+  /* Raw sbrk(). */
+  brk = sbrk (0);
+  CHECK (sbrk (8192) == brk, "sbrk 8192");
+  for (i = 0; i < 8192; i++)
+    if (brk[i] != 0)
+      fail ("byte %zu of new heap is not zero", i);
+  memset (brk, 'x', 8192);
+  CHECK (sbrk (-8192) == brk + 8192, "sbrk -8192");
+  CHECK (sbrk (0) == brk, "heap shrank");
+
+  /* Anonymous mapping. */
+  CHECK ((map = mmap_anon (anon, 3 * 4096)) != MAP_FAILED, "mmap_anon");
+  for (i = 0; i < 3 * 4096; i++)
+    if (anon[i] != 0)
+      fail ("byte %zu of anonymous mapping is not zero", i);
+  memset (anon, 'y', 3 * 4096);
+  munmap (map);
+
+  /* malloc() and friends. */
+  arc4_init (&arc4, "heap", 4);
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      uint16_t r;
+      arc4_crypt (&arc4, &r, sizeof r);
+      sizes[i] = i % 16 == 0 ? r % 20000 + 1 : r % 700 + 1;
+      blocks[i] = malloc (sizes[i]);
+      if (blocks[i] == NULL)
+        fail ("malloc of %zu bytes failed", sizes[i]);
+      fill (i);
+    }
+  for (i = 0; i < BLOCK_CNT; i += 2)
+    {
+      verify (i);
+      sizes[i] *= 3;
+      p = realloc (blocks[i], sizes[i]);
+      if (p == NULL)
+        fail ("realloc to %zu bytes failed", sizes[i]);
+      blocks[i] = p;
+      fill (i);
+    }
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      verify (i);
+      free (blocks[i]);
+    }
+  msg ("malloc, realloc, free");
+  CHECK ((char *) sbrk (0) - brk < 8 * 4096,
+         "heap shrinks after free");
+}
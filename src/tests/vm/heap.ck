@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(heap) begin
+(heap) sbrk 8192
+(heap) sbrk -8192
+(heap) heap shrank
+(heap) mmap_anon
+(heap) malloc, realloc, free
+(heap) heap shrinks after free
+(heap) end
+EOF
+pass;
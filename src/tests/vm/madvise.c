@@ -0,0 +1,53 @@
+/* Gives the VM each kind of advice about a file mapping and
+   about anonymous memory, and checks that the data seen
+   afterward is correct.  Discarding anonymous memory must leave
+   it zeroed. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+
+static char buf[PAGE_SIZE * 4] __attribute__ ((aligned (PAGE_SIZE)));
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  int handle;
+  mapid_t map;
+  size_t i;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((map = mmap (handle, actual)) != MAP_FAILED, "mmap \"sample.txt\"");
+
+  CHECK (madvise (actual, PAGE_SIZE, MADV_SEQUENTIAL) == 0,
+         "madvise sequential");
+  CHECK (madvise (actual, PAGE_SIZE, MADV_WILLNEED) == 0,
+         "madvise willneed");
+  if (memcmp (actual, sample, strlen (sample)))
+    fail ("read of mmap'd file reported bad data");
+  CHECK (madvise (actual, PAGE_SIZE, MADV_DONTNEED) == 0,
+         "madvise dontneed");
+  if (memcmp (actual, sample, strlen (sample)))
+    fail ("read of mmap'd file after dontneed reported bad data");
+  munmap (map);
+
+  memset (buf, 'x', sizeof buf);
+  CHECK (madvise (buf, sizeof buf, MADV_RANDOM) == 0, "madvise random");
+  CHECK (madvise (buf, sizeof buf, MADV_DONTNEED) == 0,
+         "madvise dontneed");
+  for (i = 0; i < sizeof buf; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu of discarded memory has value %02hhx (should be 0)",
+            i, buf[i]);
+
+  CHECK (madvise (buf + 1, PAGE_SIZE, MADV_NORMAL) == -1,
+         "madvise misaligned address (must return -1)");
+  CHECK (madvise (actual, PAGE_SIZE, MADV_NORMAL) == -1,
+         "madvise unmapped memory (must return -1)");
+  close (handle);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise) begin
+(madvise) open "sample.txt"
+(madvise) mmap "sample.txt"
+(madvise) madvise sequential
+(madvise) madvise willneed
+(madvise) madvise dontneed
+(madvise) madvise random
+(madvise) madvise dontneed
+(madvise) madvise misaligned address (must return -1)
+(madvise) madvise unmapped memory (must return -1)
+(madvise) end
+EOF
+pass;
@@ -0,0 +1,37 @@
+/* Maps a shared memory segment and runs child-shm, which maps it
+   by name, to verify that each process sees the other's writes.
+   Then verifies that unmapping the last mapping frees the
+   segment, so that mapping the name again creates a new one. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char *shm = (char *) 0x54321000;
+  pid_t child;
+  size_t i;
+
+  CHECK (shm_map ("shm-share", 2 * 4096, shm) != MAP_FAILED,
+         "shm_map \"shm-share\"");
+  for (i = 0; i < 2 * 4096; i++)
+    if (shm[i] != 0)
+      fail ("byte %zu of new segment is not zero", i);
+  strlcpy (shm, "hello, child", 4096);
+
+  CHECK ((child = exec ("child-shm")) != -1, "exec \"child-shm\"");
+  CHECK (wait (child) == 0, "wait for child");
+  CHECK (!strcmp (shm + 4096, "hello, parent"), "check child's write");
+
+  CHECK (shm_map ("shm-share", 3 * 4096, shm + 0x100000) == MAP_FAILED,
+         "shm_map too much of \"shm-share\" (must fail)");
+  CHECK (shm_unmap (shm) == 0, "shm_unmap \"shm-share\"");
+  CHECK (shm_map ("shm-share", 3 * 4096, shm) != MAP_FAILED,
+         "shm_map \"shm-share\" anew");
+  for (i = 0; i < 3 * 4096; i++)
+    if (shm[i] != 0)
+      fail ("byte %zu of recreated segment is not zero", i);
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(shm-share) begin
+(shm-share) shm_map "shm-share"
+(shm-share) exec "child-shm"
+(child-shm) begin
+(child-shm) shm_map "shm-share"
+(child-shm) check parent's write
+(child-shm) end
+child-shm: exit(0)
+(shm-share) wait for child
+(shm-share) check child's write
+(shm-share) shm_map too much of "shm-share" (must fail)
+(shm-share) shm_unmap "shm-share"
+(shm-share) shm_map "shm-share" anew
+(shm-share) end
+shm-share: exit(0)
+EOF
+pass;
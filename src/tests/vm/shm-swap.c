@@ -0,0 +1,37 @@
+/* Maps a 2 MB shared memory segment and forks a child, which
+   inherits the mapping and fills every page of it.  The segment
+   is too big to stay in memory, so verifying the child's data in
+   the parent requires the segment's pages to be written to swap
+   and read back. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (2 * 1024 * 1024)
+
+void
+test_main (void)
+{
+  char *shm = (char *) 0x10000000;
+  pid_t child;
+  size_t i;
+
+  CHECK (shm_map ("shm-swap", SIZE, shm) != MAP_FAILED,
+         "shm_map \"shm-swap\"");
+
+  child = fork ();
+  if (child == 0)
+    {
+      for (i = 0; i < SIZE; i += 4096)
+        memset (shm + i, (i / 4096) & 0xff, 4096);
+      exit (81);
+    }
+  CHECK (child != -1 && wait (child) == 81, "fork child to fill segment");
+
+  msg ("check child's writes");
+  for (i = 0; i < SIZE; i++)
+    if ((unsigned char) shm[i] != ((i / 4096) & 0xff))
+      fail ("byte %zu of segment is %d", i, shm[i]);
+}
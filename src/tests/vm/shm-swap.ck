@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(shm-swap) begin
+(shm-swap) shm_map "shm-swap"
+shm-swap: exit(81)
+(shm-swap) fork child to fill segment
+(shm-swap) check child's writes
+(shm-swap) end
+shm-swap: exit(0)
+EOF
+pass;
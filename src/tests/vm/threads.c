@@ -0,0 +1,198 @@
+/* Runs threads that share the process's memory, heap, and file
+   descriptors and joins them, then checks how a process with
+   several threads exits: not before its last thread leaves,
+   with that thread's status, or at once, taking its other
+   threads along, when one of them calls exit(), even a thread
+   blocked reading a pipe that only the process can write. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4
+#define SLICE 1000
+#define BLOCK_CNT 64
+
+static int numbers[THREAD_CNT * SLICE];
+static int sums[THREAD_CNT];
+static int fds[2];
+static volatile int leaving;
+static volatile bool spinning = true;
+static volatile bool reading;
+
+/* Sums slice IDX_ of NUMBERS into SUMS[IDX_], and returns IDX_
+   plus 100. */
+static int
+sum_slice (void *idx_)
+{
+  int idx = (int) idx_;
+  int i;
+
+  for (i = idx * SLICE; i < (idx + 1) * SLICE; i++)
+    sums[idx] += numbers[i];
+  return idx + 100;
+}
+
+/* Allocates blocks of many sizes, some bigger than a page, fills
+   each with a byte of its own, checks them all, and frees them,
+   over and over.  Returns 0 if every block held what it should,
+   otherwise 1. */
+static int
+use_heap (void *aux UNUSED)
+{
+  char *blocks[BLOCK_CNT];
+  int round, i;
+
+  for (round = 0; round < 20; round++)
+    {
+      for (i = 0; i < BLOCK_CNT; i++)
+        {
+          size_t size = 16 << (i % 10);
+          blocks[i] = malloc (size);
+          if (blocks[i] == NULL)
+            return 1;
+          memset (blocks[i], i, size);
+        }
+      for (i = 0; i < BLOCK_CNT; i++)
+        {
+          size_t size = 16 << (i % 10);
+          size_t j;
+
+          for (j = 0; j < size; j++)
+            if (blocks[i][j] != i)
+              return 1;
+          free (blocks[i]);
+        }
+    }
+  return 0;
+}
+
+/* Writes to the pipe that the first thread opened. */
+static int
+write_pipe (void *aux UNUSED)
+{
+  return write (fds[1], "hello", 5) == 5 ? 0 : 1;
+}
+
+/* Waits until the first thread is leaving, and a while longer,
+   then writes to the pipe and leaves with status 7. */
+static int
+outlive (void *aux UNUSED)
+{
+  int i;
+
+  while (!leaving)
+    continue;
+  for (i = 0; i < 1000000; i++)
+    leaving++;
+  write (fds[1], "x", 1);
+  return 7;
+}
+
+/* Runs until something else ends the process. */
+static int
+spin (void *aux UNUSED)
+{
+  while (spinning)
+    continue;
+  return 0;
+}
+
+/* Reads from the pipe, which blocks until something else ends
+   the process, since no one writes to it. */
+static int
+read_pipe (void *aux UNUSED)
+{
+  char c;
+
+  reading = true;
+  return read (fds[0], &c, 1);
+}
+
+void
+test_main (void)
+{
+  tid_t tids[THREAD_CNT];
+  char buf[5];
+  pid_t child;
+  int i;
+
+  for (i = 0; i < THREAD_CNT * SLICE; i++)
+    numbers[i] = i;
+  CHECK (pipe (fds) == 0, "pipe");
+
+  msg ("create threads");
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      tids[i] = thread_create (sum_slice, (void *) i);
+      if (tids[i] == TID_ERROR)
+        fail ("thread_create %d failed", i);
+    }
+  msg ("join threads");
+  for (i = 0; i < THREAD_CNT; i++)
+    if (thread_join (tids[i]) != i + 100)
+      fail ("thread %d returned the wrong status", i);
+  msg ("check sums");
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      int lo = i * SLICE, hi = (i + 1) * SLICE - 1;
+      if (sums[i] != (lo + hi) * SLICE / 2)
+        fail ("sum %d is %d", i, sums[i]);
+    }
+  CHECK (thread_join (tids[0]) == -1, "join thread again (must fail)");
+
+  msg ("malloc from several threads");
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      tids[i] = thread_create (use_heap, NULL);
+      if (tids[i] == TID_ERROR)
+        fail ("thread_create %d failed", i);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    if (thread_join (tids[i]) != 0)
+      fail ("thread %d saw a corrupted heap", i);
+
+  CHECK (thread_join (thread_create (write_pipe, NULL)) == 0,
+         "write pipe from a thread");
+  CHECK (read (fds[0], buf, 5) == 5 && !memcmp (buf, "hello", 5),
+         "read thread's write");
+
+  child = fork ();
+  if (child == 0)
+    {
+      if (thread_create (outlive, NULL) == TID_ERROR)
+        exit (1);
+      leaving = 1;
+      thread_exit (3);
+    }
+  CHECK (child != -1 && wait (child) == 7,
+         "process outlives its first thread");
+  CHECK (read (fds[0], buf, 1) == 1 && buf[0] == 'x',
+         "read last thread's write");
+
+  child = fork ();
+  if (child == 0)
+    {
+      for (i = 0; i < 3; i++)
+        if (thread_create (spin, NULL) == TID_ERROR)
+          exit (1);
+      exit (5);
+    }
+  CHECK (child != -1 && wait (child) == 5, "exit() ends every thread");
+
+  child = fork ();
+  if (child == 0)
+    {
+      if (pipe (fds) != 0 || thread_create (read_pipe, NULL) == TID_ERROR)
+        exit (1);
+      while (!reading)
+        continue;
+      for (i = 0; i < 1000000; i++)
+        leaving++;
+      exit (6);
+    }
+  CHECK (child != -1 && wait (child) == 6,
+         "exit() ends a thread blocked on a pipe");
+}
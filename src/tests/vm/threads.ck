@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(threads) begin
+(threads) pipe
+(threads) create threads
+(threads) join threads
+(threads) check sums
+(threads) join thread again (must fail)
+(threads) malloc from several threads
+(threads) write pipe from a thread
+(threads) read thread's write
+threads: exit(7)
+(threads) process outlives its first thread
+(threads) read last thread's write
+threads: exit(5)
+(threads) exit() ends every thread
+threads: exit(6)
+(threads) exit() ends a thread blocked on a pipe
+(threads) end
+threads: exit(0)
+EOF
+pass;
@@ -31,6 +31,12 @@
 #else
 #include "tests/threads/tests.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/shm.h"
+#include "vm/swap.h"
+#endif
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
@@ -59,6 +65,7 @@ static size_t user_page_limit = SIZE_MAX;
 
 static void bss_init (void);
 static void paging_init (void);
+static bool cpu_has_pge (void);
 
 static char **read_command_line (void);
 static char **parse_options (char **argv);
@@ -127,6 +134,14 @@ main (void)
   filesys_init (format_filesys);
 #endif
 
+#ifdef VM
+  /* Initialize virtual memory. */
+  page_init ();
+  frame_init ();
+  swap_init ();
+  shm_init ();
+#endif
+
   printf ("Boot complete.\n");
   
   /* Run actions specified on kernel command line. */
@@ -150,6 +165,11 @@ bss_init (void)
   memset (&_start_bss, 0, &_end_bss - &_start_bss);
 }
 
+/* Global page support.  See [IA32-v3a] 2.5 "Control
+   Registers" and [IA32-v2a] "CPUID--CPU Identification". */
+#define CR4_PGE 0x00000080      /* Page Global Enable. */
+#define CPUID_PGE 0x00002000    /* CPUID(1).EDX: PGE supported. */
+
 /* Populates the base page directory and page table with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points init_page_dir to the page
@@ -159,8 +179,15 @@ paging_init (void)
 {
   uint32_t *pd, *pt;
   size_t page;
+  uint32_t global;
   extern char _start, _end_kernel_text;
 
+  /* The kernel mapping is the same in every page directory, so
+     it is marked "global" to keep it in the TLB when CR3 is
+     reloaded, if the CPU supports global pages.  See [IA32-v3a]
+     3.12 "Translation Lookaside Buffers (TLBs)". */
+  global = cpu_has_pge () ? PTE_G : 0;
+
   pd = init_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   pt = NULL;
   for (page = 0; page < init_ram_pages; page++)
@@ -177,7 +204,7 @@ paging_init (void)
           pd[pde_idx] = pde_create (pt);
         }
 
-      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
+      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text) | global;
     }
 
   /* Store the physical address of the page directory into CR3
@@ -186,6 +213,26 @@ paging_init (void)
      to/from Control Registers" and [IA32-v3a] 3.7.5 "Base Address
      of the Page Directory". */
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)));
+
+  /* Enable global pages by setting PGE in CR4.  See [IA32-v3a]
+     2.5 "Control Registers". */
+  if (global)
+    {
+      uint32_t cr4;
+      asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+      asm volatile ("movl %0, %%cr4" : : "r" (cr4 | CR4_PGE) : "memory");
+    }
+}
+
+/* Returns true if the CPU supports global pages, false
+   otherwise.  See [IA32-v2a] "CPUID--CPU Identification". */
+static bool
+cpu_has_pge (void)
+{
+  uint32_t eax, ebx, ecx, edx;
+
+  asm ("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (1));
+  return (edx & CPUID_PGE) != 0;
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -259,6 +306,14 @@ parse_options (char **argv)
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-sl"))
+        stack_page_limit = atoi (value);
+      else if (!strcmp (name, "-fa"))
+        fault_around_limit = atoi (value);
+      else if (!strcmp (name, "-zs"))
+        swap_cache_limit = atoi (value);
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -381,6 +436,11 @@ usage (void)
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+          "  -sl=COUNT          Limit user stacks to COUNT pages.\n"
+          "  -fa=COUNT          Fault in up to COUNT file pages at once.\n"
+          "  -zs=COUNT          Keep up to COUNT pages of compressed swap in RAM.\n"
 #endif
           );
   shutdown_power_off ();
@@ -9,6 +9,10 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "devices/timer.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#include "userprog/process.h"
+#endif
 
 /* Programmable Interrupt Controller (PIC) registers.
    A PC has two PICs, called the master and slave PICs, with the
@@ -386,6 +390,18 @@ intr_handler (struct intr_frame *frame)
       if (yield_on_return) 
         thread_yield (); 
     }
+
+#ifdef USERPROG
+  /* A thread about to return to user mode leaves instead if
+     another thread is taking its process down.  This catches
+     threads that keep running in user mode at the next timer
+     interrupt. */
+  if (frame->cs == SEL_UCSEG && process_exiting ()) 
+    {
+      intr_enable ();
+      thread_exit ();
+    }
+#endif
 }
 
 /* Handles an unexpected interrupt with interrupt frame F.  An
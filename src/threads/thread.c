@@ -463,6 +463,21 @@ init_thread (struct thread *t, const char *name, int priority)
   t->stack = (uint8_t *) t + PGSIZE;
   t->priority = priority;
   t->magic = THREAD_MAGIC;
+#ifdef USERPROG
+  t->process = t;
+  t->exit_code = -1;
+  list_init (&t->children);
+  sema_init (&t->child_exited, 0);
+  list_init (&t->threads);
+  cond_init (&t->threads_gone);
+  t->stack_slot = -1;
+  lock_init (&t->process_lock);
+#endif
+#ifdef VM
+  lock_init (&t->pages_lock);
+  lock_init (&t->mappings_lock);
+  list_init (&t->mappings);
+#endif
 
   old_level = intr_disable ();
   list_push_back (&all_list, &t->allelem);
@@ -4,6 +4,7 @@
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
+#include "threads/synch.h"
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -95,7 +96,42 @@ struct thread
 
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
+    struct thread *process;             /* Process's first thread. */
     uint32_t *pagedir;                  /* Page directory. */
+    struct file *bin_file;              /* Executable, kept open. */
+    int exit_code;                      /* Exit code. */
+    struct wait_status *wait_status;    /* This process's or thread's status. */
+    struct list children;               /* Completion status of children. */
+    struct semaphore child_exited;      /* Upped when a child exits. */
+    struct list threads;                /* Completion status of threads. */
+    int thread_cnt;                     /* Number of other threads running. */
+    struct condition threads_gone;      /* Signaled when THREAD_CNT drops to 0. */
+    unsigned stack_slots;               /* User stacks in use, one bit each. */
+    int stack_slot;                     /* This thread's user stack, or -1. */
+    bool exiting;                       /* Process exiting? */
+    bool thread_exited;                 /* Left with thread_exit(), not exit()? */
+    struct lock process_lock;           /* Protects process state above. */
+
+    /* Owned by userprog/syscall.c. */
+    struct file_descriptor **fds;       /* File descriptors, by handle. */
+    size_t fd_cnt;                      /* Number of elements in fds. */
+    struct bitmap *fd_map;              /* Handles in use. */
+    struct bitmap *fd_cloexec;          /* Handles to close on exec(). */
+    int next_mapid;                     /* Next mapping id. */
+    struct io_ring *io_ring;            /* User's I/O ring, if any. */
+    struct file_descriptor *held_fds[2]; /* Descriptors in use by a call. */
+#endif
+#ifdef VM
+    /* Owned by vm/page.c. */
+    struct hash *pages;                 /* Supplemental page table. */
+    struct lock pages_lock;             /* Protects PAGES. */
+    void *user_esp;                     /* User's stack pointer. */
+
+    /* Owned by userprog/syscall.c. */
+    struct lock mappings_lock;          /* Protects these and NEXT_MAPID. */
+    struct list mappings;               /* Memory-mapped files. */
+    uint8_t *heap_start;                /* Start of heap. */
+    uint8_t *heap_brk;                  /* End of heap (the "break"). */
 #endif
 
     /* Owned by thread.c. */
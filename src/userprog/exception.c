@@ -2,13 +2,21 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include "userprog/gdt.h"
+#include "userprog/syscall.h"
+#include "userprog/usercopy.h"
+#include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
 
 static void kill (struct intr_frame *);
+static void debug (struct intr_frame *);
 static void page_fault (struct intr_frame *);
 
 /* Registers handlers for interrupts that can be caused by user
@@ -20,9 +28,10 @@ static void page_fault (struct intr_frame *);
    signals.  Instead, we'll make them simply kill the user
    process.
 
-   Page faults are an exception.  Here they are treated the same
-   way as other exceptions, but this will need to change to
-   implement virtual memory.
+   Page faults are an exception.  With VM, a fault on a page that
+   is in the process's supplemental page table brings the page
+   in.  Any other page fault is treated the same way as other
+   exceptions.
 
    Refer to [IA32-v3a] section 5.15 "Exception and Interrupt
    Reference" for a description of each of these exceptions. */
@@ -43,7 +52,7 @@ exception_init (void)
      caused indirectly, e.g. #DE can be caused by dividing by
      0.  */
   intr_register_int (0, 0, INTR_ON, kill, "#DE Divide Error");
-  intr_register_int (1, 0, INTR_ON, kill, "#DB Debug Exception");
+  intr_register_int (1, 0, INTR_ON, debug, "#DB Debug Exception");
   intr_register_int (6, 0, INTR_ON, kill, "#UD Invalid Opcode Exception");
   intr_register_int (7, 0, INTR_ON, kill,
                      "#NM Device Not Available Exception");
@@ -108,6 +117,23 @@ kill (struct intr_frame *f)
     }
 }
 
+/* Debug exception handler.  SYSENTER doesn't clear the trap
+   flag, so a user program that sets the flag and then executes
+   SYSENTER takes a single-step trap at the first instruction of
+   sysenter_entry, in the kernel.  We clear the flag there and
+   let the system call proceed.  Any other debug exception kills
+   the process. */
+static void
+debug (struct intr_frame *f)
+{
+  if (f->cs == SEL_KCSEG && f->eip == sysenter_entry)
+    {
+      f->eflags &= ~FLAG_TF;
+      return;
+    }
+  kill (f);
+}
+
 /* Page fault handler.  This is a skeleton that must be filled in
    to implement virtual memory.  Some solutions to project 2 may
    also require modifying this code.
@@ -148,9 +174,32 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
-  /* To implement virtual memory, delete the rest of the function
-     body, and replace it with code that brings in the page to
-     which fault_addr refers. */
+#ifdef VM
+  /* The stack pointer decides whether an access below the stack
+     grows it.  For a fault taken in the kernel, the user's stack
+     pointer is the one saved on entry to the system call. */
+  if (user)
+    thread_current ()->user_esp = f->esp;
+
+  /* Let the pager bring in the page, if it is one the process
+     has but that is not yet in memory.  This also covers faults
+     taken by the kernel on user addresses, e.g. during system
+     calls. */
+  if (not_present && page_in (fault_addr, write))
+    return;
+
+  /* A write to a page that is read-only only because it shares
+     its frame with another process gives the writer its own
+     copy. */
+  if (!not_present && write && page_unshare (fault_addr))
+    return;
+#endif
+
+  /* A bad user address passed to a system call makes the copy
+     that touched it fail. */
+  if (!user && is_user_vaddr (fault_addr) && usercopy_fixup (f))
+    return;
+
   printf ("Page fault at %p: %s error %s page in %s context.\n",
           fault_addr,
           not_present ? "not present" : "rights violation",
@@ -7,6 +7,7 @@
 #include "threads/palloc.h"
 
 static uint32_t *active_pd (void);
+static void load_pd (uint32_t *);
 static void invalidate_pagedir (uint32_t *);
 
 /* Creates a new page directory that has mappings for kernel
@@ -23,7 +24,12 @@ pagedir_create (void)
 }
 
 /* Destroys page directory PD, freeing all the pages it
-   references. */
+   references.  With VM, the frames that user pages occupy
+   belong to the frame table, which must already have released
+   them, so only the page tables themselves are freed here.  (A
+   frame that other processes still map, such as a shared text
+   page, outlives PD; releasing it only dropped its reference
+   count.) */
 void
 pagedir_destroy (uint32_t *pd) 
 {
@@ -37,11 +43,13 @@ pagedir_destroy (uint32_t *pd)
     if (*pde & PTE_P) 
       {
         uint32_t *pt = pde_get_pt (*pde);
+#ifndef VM
         uint32_t *pte;
         
         for (pte = pt; pte < pt + PGSIZE / sizeof *pte; pte++)
           if (*pte & PTE_P) 
             palloc_free_page (pte_get_page (*pte));
+#endif
         palloc_free_page (pt);
       }
   palloc_free_page (pd);
@@ -185,6 +193,26 @@ pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty)
     }
 }
 
+/* Makes the PTE for virtual page VPAGE in PD writable by the
+   user process if WRITABLE is true, read-only otherwise.  The
+   page must be mapped. */
+void
+pagedir_set_writable (uint32_t *pd, const void *vpage, bool writable) 
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+
+  ASSERT (pte != NULL && (*pte & PTE_P) != 0);
+  if (writable)
+    *pte |= PTE_W;
+  else
+    *pte &= ~(uint32_t) PTE_W;
+
+  /* Flush a stale read-only entry as well as a stale writable
+     one: the kernel may write to the page right away, and a
+     fault then would find nothing to do. */
+  invalidate_pagedir (pd);
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PD has been
    accessed recently, that is, between the time the PTE was
    installed and the last time it was cleared.  Returns false if
@@ -222,6 +250,17 @@ pagedir_activate (uint32_t *pd)
   if (pd == NULL)
     pd = init_page_dir;
 
+  /* Loading CR3 flushes the user mappings from the TLB, so don't
+     bother if PD is already active. */
+  if (pd != active_pd ())
+    load_pd (pd);
+}
+
+/* Loads page directory PD into CR3, flushing all but the global
+   entries from the TLB. */
+static void
+load_pd (uint32_t *pd) 
+{
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
      new page tables immediately.  See [IA32-v2a] "MOV--Move
@@ -256,8 +295,9 @@ invalidate_pagedir (uint32_t *pd)
 {
   if (active_pd () == pd) 
     {
-      /* Re-activating PD clears the TLB.  See [IA32-v3a] 3.12
-         "Translation Lookaside Buffers (TLBs)". */
-      pagedir_activate (pd);
+      /* Reloading CR3 clears the TLB of user mappings, which are
+         never global.  See [IA32-v3a] 3.12 "Translation
+         Lookaside Buffers (TLBs)". */
+      load_pd (pd);
     } 
 }
@@ -0,0 +1,211 @@
+#include "userprog/pipe.h"
+#include <debug.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Pipes.
+
+   A pipe's data lives in a ring buffer of whole pages.  Data
+   moves in and out of the buffer only through the functions
+   passed to pipe_drain() and pipe_fill(), which are called
+   without the pipe's lock held, so that they may fault on user
+   memory or do file I/O.  Meanwhile, the region of the buffer
+   they work on is reserved for them: only one thread at a time
+   drains a pipe, and only one fills it, and the other side
+   never touches that region until the mover is done with it.
+
+   Each end is counted as open until pipe_close() is called for
+   it.  Reading from a pipe whose write end is closed returns
+   end of file once the buffer is empty; writing to a pipe whose
+   read end is closed fails. */
+struct pipe
+  {
+    struct lock lock;           /* Protects the members below. */
+    struct condition readable;  /* Data or end of file, or drainer done. */
+    struct condition writable;  /* Room or no readers, or filler done. */
+    uint8_t *buf;               /* Ring buffer. */
+    size_t page_cnt;            /* Size of BUF in pages. */
+    size_t size;                /* Size of BUF in bytes. */
+    size_t head;                /* Bytes drained, ever. */
+    size_t tail;                /* Bytes filled, ever. */
+    bool reader;                /* Read end open? */
+    bool writer;                /* Write end open? */
+    bool draining;              /* A thread is draining? */
+    bool filling;               /* A thread is filling? */
+  };
+
+/* Creates and returns a new pipe with a buffer of PAGE_CNT
+   pages, with both ends open.  Returns a null pointer if memory
+   is not available. */
+struct pipe *
+pipe_create (size_t page_cnt) 
+{
+  struct pipe *p;
+
+  ASSERT (page_cnt > 0);
+
+  p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+  p->buf = palloc_get_multiple (0, page_cnt);
+  if (p->buf == NULL) 
+    {
+      free (p);
+      return NULL;
+    }
+  lock_init (&p->lock);
+  cond_init (&p->readable);
+  cond_init (&p->writable);
+  p->page_cnt = page_cnt;
+  p->size = page_cnt * PGSIZE;
+  p->head = p->tail = 0;
+  p->reader = p->writer = true;
+  p->draining = p->filling = false;
+  return p;
+}
+
+/* Releases P's lock, which the caller must hold, and frees P if
+   both of its ends are closed and no thread is moving data. */
+static void
+pipe_unlock (struct pipe *p) 
+{
+  bool dead = !p->reader && !p->writer && !p->draining && !p->filling;
+
+  lock_release (&p->lock);
+  if (dead) 
+    {
+      palloc_free_multiple (p->buf, p->page_cnt);
+      free (p);
+    }
+}
+
+/* Closes P's write end if WRITER is true, otherwise its read
+   end, waking any thread waiting on the other end. */
+void
+pipe_close (struct pipe *p, bool writer) 
+{
+  lock_acquire (&p->lock);
+  if (writer)
+    {
+      ASSERT (p->writer);
+      p->writer = false;
+      cond_broadcast (&p->readable, &p->lock);
+    }
+  else
+    {
+      ASSERT (p->reader);
+      p->reader = false;
+      cond_broadcast (&p->writable, &p->lock);
+    }
+  pipe_unlock (p);
+}
+
+/* Moves up to SIZE bytes of data out of pipe P, by passing each
+   contiguous run of it in the buffer to XFER along with AUX.
+   Waits until P has data, unless its write end is closed.
+   Returns the number of bytes moved, which is 0 at end of file,
+   or -1 if XFER fails before moving any. */
+int
+pipe_drain (struct pipe *p, size_t size, pipe_xfer_func *xfer, void *aux) 
+{
+  size_t done = 0;
+  int error = 0;
+
+  lock_acquire (&p->lock);
+  while (p->draining || (p->head == p->tail && p->writer))
+    cond_wait (&p->readable, &p->lock);
+  p->draining = true;
+
+  while (done < size && p->head != p->tail) 
+    {
+      size_t ofs = p->head % p->size;
+      size_t cnt = p->tail - p->head;
+      int moved;
+
+      if (cnt > p->size - ofs)
+        cnt = p->size - ofs;
+      if (cnt > size - done)
+        cnt = size - done;
+
+      lock_release (&p->lock);
+      moved = xfer (p->buf + ofs, cnt, aux);
+      lock_acquire (&p->lock);
+      if (moved < 0) 
+        {
+          error = -1;
+          break;
+        }
+
+      p->head += moved;
+      done += moved;
+      cond_broadcast (&p->writable, &p->lock);
+      if ((size_t) moved < cnt)
+        break;
+    }
+
+  p->draining = false;
+  cond_broadcast (&p->readable, &p->lock);
+  pipe_unlock (p);
+  return done > 0 ? (int) done : error;
+}
+
+/* Moves up to SIZE bytes of data into pipe P, by passing each
+   contiguous run of free space in the buffer to XFER along with
+   AUX.  Waits for space while the buffer is full: until all
+   SIZE bytes are moved if ALL is true, otherwise only until
+   some are.  Stops early if XFER moves less than asked, at the
+   end of its data.  Returns the number of bytes moved, or -1 if
+   P's read end is closed or XFER fails before any are moved. */
+int
+pipe_fill (struct pipe *p, size_t size, pipe_xfer_func *xfer, void *aux,
+           bool all) 
+{
+  size_t done = 0;
+  int error = -1;
+
+  lock_acquire (&p->lock);
+  while (p->filling)
+    cond_wait (&p->writable, &p->lock);
+  p->filling = true;
+
+  while (done < size && p->reader) 
+    {
+      size_t ofs = p->tail % p->size;
+      size_t cnt = p->size - (p->tail - p->head);
+      int moved;
+
+      if (cnt == 0) 
+        {
+          if (done > 0 && !all)
+            break;
+          cond_wait (&p->writable, &p->lock);
+          continue;
+        }
+      if (cnt > p->size - ofs)
+        cnt = p->size - ofs;
+      if (cnt > size - done)
+        cnt = size - done;
+
+      lock_release (&p->lock);
+      moved = xfer (p->buf + ofs, cnt, aux);
+      lock_acquire (&p->lock);
+      if (moved < 0)
+        break;
+
+      p->tail += moved;
+      done += moved;
+      cond_broadcast (&p->readable, &p->lock);
+      if ((size_t) moved < cnt) 
+        {
+          error = 0;
+          break;
+        }
+    }
+
+  p->filling = false;
+  cond_broadcast (&p->writable, &p->lock);
+  pipe_unlock (p);
+  return done > 0 || size == 0 ? (int) done : error;
+}
@@ -0,0 +1,24 @@
+#ifndef USERPROG_PIPE_H
+#define USERPROG_PIPE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* A pipe: a ring buffer in kernel memory with a read end and a
+   write end. */
+struct pipe;
+
+/* Moves up to SIZE bytes between DATA, in a pipe's buffer, and
+   some other place described by AUX.  Returns the number of
+   bytes moved, which is less than SIZE only at the end of the
+   other place's data, or -1 on error. */
+typedef int pipe_xfer_func (void *data, size_t size, void *aux);
+
+struct pipe *pipe_create (size_t page_cnt);
+void pipe_close (struct pipe *, bool writer);
+
+int pipe_drain (struct pipe *, size_t size, pipe_xfer_func *, void *aux);
+int pipe_fill (struct pipe *, size_t size, pipe_xfer_func *, void *aux,
+               bool all);
+
+#endif /* userprog/pipe.h */
@@ -7,62 +7,242 @@
 #include <string.h>
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
+#include "userprog/syscall.h"
 #include "userprog/tss.h"
+#include "userprog/usercopy.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#endif
 
 static thread_func start_process NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
 
-/* Starts a new thread running a user program loaded from
-   FILENAME.  The new thread may be scheduled (and may even exit)
-   before process_execute() returns.  Returns the new process's
-   thread id, or TID_ERROR if the thread cannot be created. */
+/* Copies the first word of command line CMD_LINE, the program
+   name, into NAME, truncating it to fit in SIZE bytes. */
+static void
+get_program_name (char *name, const char *cmd_line, size_t size) 
+{
+  size_t len;
+
+  cmd_line += strspn (cmd_line, " ");
+  len = strcspn (cmd_line, " ");
+  strlcpy (name, cmd_line, len + 1 < size ? len + 1 : size);
+}
+
+/* Returns the running process: the first thread of the process
+   that the running thread belongs to, whose `struct thread'
+   holds the state that all of the process's threads share, such
+   as its page directory, its supplemental page table, its file
+   descriptors, and its children. */
+struct thread *
+process_current (void) 
+{
+  return thread_current ()->process;
+}
+
+/* The completion status of a child process, shared by the
+   child and its parent, so that it outlives whichever of them
+   exits first.  The parent keeps it in its list of children;
+   the child points to it from its wait_status member.
+
+   A thread that a process creates beyond its first has one too,
+   kept in the process's list of threads, with a null PARENT. */
+struct wait_status
+  {
+    struct list_elem elem;              /* Element in children or threads. */
+    struct lock lock;                   /* Protects ref_cnt. */
+    int ref_cnt;                        /* 2: child and parent alive,
+                                           1: just one of them alive,
+                                           0: both dead. */
+    struct thread *parent;              /* Parent, valid if REF_CNT is 2. */
+    tid_t tid;                          /* Child's thread id. */
+    int exit_code;                      /* Child's exit code, once dead. */
+    struct semaphore dead;              /* Upped when the child exits. */
+  };
+
+/* Returns a new completion status for a child of the running
+   process, or a null pointer if memory is not available. */
+static struct wait_status *
+wait_status_create (void) 
+{
+  struct wait_status *ws = malloc (sizeof *ws);
+  if (ws != NULL) 
+    {
+      lock_init (&ws->lock);
+      ws->ref_cnt = 2;
+      ws->parent = process_current ();
+      ws->tid = TID_ERROR;
+      ws->exit_code = -1;
+      sema_init (&ws->dead, 0);
+    }
+  return ws;
+}
+
+/* Drops the child's or the parent's reference to WS, and frees
+   WS if that was the last one. */
+static void
+wait_status_release (struct wait_status *ws) 
+{
+  int ref_cnt;
+
+  lock_acquire (&ws->lock);
+  ref_cnt = --ws->ref_cnt;
+  lock_release (&ws->lock);
+  if (ref_cnt == 0)
+    free (ws);
+}
+
+/* Removes the completion status for TID from LIST, the running
+   process's children or threads, and returns it, or returns a
+   null pointer if LIST has none for TID.  Taking the status out
+   of LIST first lets only one thread wait for TID. */
+static struct wait_status *
+wait_status_take (struct list *list, tid_t tid) 
+{
+  struct thread *proc = process_current ();
+  struct list_elem *e;
+
+  lock_acquire (&proc->process_lock);
+  for (e = list_begin (list); e != list_end (list); e = list_next (e)) 
+    {
+      struct wait_status *ws = list_entry (e, struct wait_status, elem);
+      if (ws->tid == tid) 
+        {
+          list_remove (&ws->elem);
+          lock_release (&proc->process_lock);
+          return ws;
+        }
+    }
+  lock_release (&proc->process_lock);
+  return NULL;
+}
+
+/* Drops the parent's reference to WS, whose child has exited and
+   which is no longer in any list, and returns the child's exit
+   code. */
+static int
+wait_status_reap (struct wait_status *ws) 
+{
+  int exit_code = ws->exit_code;
+
+  wait_status_release (ws);
+  return exit_code;
+}
+
+/* Enters WS, for the new child process TID, in the running
+   process's children if SUCCESS is true, and returns TID.
+   Otherwise, the child has failed to start and is exiting, so
+   drops the parent's reference to WS and returns TID_ERROR. */
+static tid_t
+wait_status_adopt (struct wait_status *ws, tid_t tid, bool success) 
+{
+  struct thread *proc = process_current ();
+
+  if (!success) 
+    {
+      wait_status_release (ws);
+      return TID_ERROR;
+    }
+  ws->tid = tid;
+  lock_acquire (&proc->process_lock);
+  list_push_back (&proc->children, &ws->elem);
+  lock_release (&proc->process_lock);
+  return tid;
+}
+
+/* Data passed from a process calling exec() to its child. */
+struct exec_info 
+  {
+    char *cmd_line;                     /* Command line, in a page. */
+    struct thread *parent;              /* Executing process. */
+    struct wait_status *wait_status;    /* Child's completion status. */
+    struct semaphore started;           /* Upped when child has started. */
+    bool success;                       /* Program loaded successfully? */
+  };
+
+/* Starts a new thread running a user program loaded from the
+   first word of CMD_LINE, passing it the words of CMD_LINE as
+   arguments, and waits for it to load the program.  The new
+   thread inherits the file descriptors of the running process.
+   Returns the new process's thread id, or TID_ERROR if the
+   thread cannot be created or the program cannot be loaded. */
 tid_t
-process_execute (const char *file_name) 
+process_execute (const char *cmd_line) 
 {
-  char *fn_copy;
+  char name[sizeof thread_current ()->name];
+  struct exec_info ei;
   tid_t tid;
 
-  /* Make a copy of FILE_NAME.
+  /* Make a copy of CMD_LINE.
      Otherwise there's a race between the caller and load(). */
-  fn_copy = palloc_get_page (0);
-  if (fn_copy == NULL)
+  ei.cmd_line = palloc_get_page (0);
+  if (ei.cmd_line == NULL)
     return TID_ERROR;
-  strlcpy (fn_copy, file_name, PGSIZE);
+  strlcpy (ei.cmd_line, cmd_line, PGSIZE);
+  ei.parent = process_current ();
+  ei.wait_status = wait_status_create ();
+  if (ei.wait_status == NULL) 
+    {
+      palloc_free_page (ei.cmd_line);
+      return TID_ERROR;
+    }
+  sema_init (&ei.started, 0);
+  ei.success = false;
 
-  /* Create a new thread to execute FILE_NAME. */
-  tid = thread_create (file_name, PRI_DEFAULT, start_process, fn_copy);
-  if (tid == TID_ERROR)
-    palloc_free_page (fn_copy); 
-  return tid;
+  /* Create a new thread to execute CMD_LINE, named after the
+     program it runs, and wait for it to load the program. */
+  get_program_name (name, cmd_line, sizeof name);
+  tid = thread_create (name, PRI_DEFAULT, start_process, &ei);
+  if (tid == TID_ERROR) 
+    {
+      palloc_free_page (ei.cmd_line);
+      free (ei.wait_status);
+      return TID_ERROR;
+    }
+  sema_down (&ei.started);
+  return wait_status_adopt (ei.wait_status, tid, ei.success);
 }
 
 /* A thread function that loads a user process and starts it
    running. */
 static void
-start_process (void *file_name_)
+start_process (void *ei_)
 {
-  char *file_name = file_name_;
+  struct exec_info *ei = ei_;
+  char *cmd_line = ei->cmd_line;
   struct intr_frame if_;
   bool success;
 
+  thread_current ()->wait_status = ei->wait_status;
+
   /* Initialize interrupt frame and load executable. */
   memset (&if_, 0, sizeof if_);
   if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
   if_.cs = SEL_UCSEG;
   if_.eflags = FLAG_IF | FLAG_MBS;
-  success = load (file_name, &if_.eip, &if_.esp);
+  success = (syscall_exec (ei->parent)
+             && load (cmd_line, &if_.eip, &if_.esp));
+  palloc_free_page (cmd_line);
+
+  /* EI is on the parent's stack, which it may leave as soon as
+     it is woken. */
+  ei->success = success;
+  sema_up (&ei->started);
 
   /* If load failed, quit. */
-  palloc_free_page (file_name);
   if (!success) 
     thread_exit ();
 
@@ -76,19 +256,530 @@ start_process (void *file_name_)
   NOT_REACHED ();
 }
 
+/* Data passed from a process calling fork() to its child. */
+struct fork_info 
+  {
+    struct thread *parent;              /* Forking process. */
+    const struct intr_frame *if_;       /* Parent's user context. */
+    struct wait_status *wait_status;    /* Child's completion status. */
+    struct semaphore done;              /* Upped when child is set up. */
+    bool success;                       /* Child set up successfully? */
+  };
+
+static thread_func start_fork NO_RETURN;
+static bool fork_address_space (struct thread *parent);
+
+/* Starts a new thread running a copy of the running user
+   process, which resumes from the system call whose user
+   context is IF_, and waits for it to set up its copy.  The
+   copy has just one thread, which continues where the running
+   thread left off.  Returns the new process's thread id, or
+   TID_ERROR if the thread cannot be created or cannot copy the
+   process. */
+tid_t
+process_fork (const struct intr_frame *if_) 
+{
+  struct thread *cur = process_current ();
+  struct fork_info fi;
+  tid_t tid;
+
+  fi.parent = cur;
+  fi.if_ = if_;
+  fi.wait_status = wait_status_create ();
+  if (fi.wait_status == NULL)
+    return TID_ERROR;
+  sema_init (&fi.done, 0);
+  fi.success = false;
+
+  tid = thread_create (cur->name, PRI_DEFAULT, start_fork, &fi);
+  if (tid == TID_ERROR)
+    {
+      free (fi.wait_status);
+      return TID_ERROR;
+    }
+  sema_down (&fi.done);
+  return wait_status_adopt (fi.wait_status, tid, fi.success);
+}
+
+/* A thread function that copies the address space and open
+   files of the forking process in FI_ and starts the copy
+   running, returning 0 from fork(). */
+static void
+start_fork (void *fi_) 
+{
+  struct fork_info *fi = fi_;
+  struct thread *t = thread_current ();
+  struct intr_frame if_ = *fi->if_;
+  bool success = false;
+
+  t->wait_status = fi->wait_status;
+  t->pagedir = pagedir_create ();
+  if (t->pagedir != NULL) 
+    {
+      process_activate ();
+      success = fork_address_space (fi->parent) && syscall_fork (fi->parent);
+    }
+
+  /* FI is on the parent's stack, which it may leave as soon as
+     it is woken. */
+  fi->success = success;
+  sema_up (&fi->done);
+  if (!success)
+    thread_exit ();
+
+  /* Return to user mode, as start_process() does. */
+  if_.eax = 0;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+
+/* Makes the running thread's address space a copy of PARENT's,
+   sharing PARENT's frames copy-on-write.  The forking thread
+   holds PARENT's `mappings_lock'.  Returns true if successful,
+   false on failure. */
+#ifdef VM
+static bool
+fork_address_space (struct thread *parent) 
+{
+  struct thread *t = thread_current ();
+
+  if (!page_table_create ())
+    return false;
+
+  lock_acquire (&filesys_lock);
+  t->bin_file = file_reopen (parent->bin_file);
+  if (t->bin_file != NULL)
+    file_deny_write (t->bin_file);
+  lock_release (&filesys_lock);
+
+  t->heap_start = parent->heap_start;
+  t->heap_brk = parent->heap_brk;
+
+  /* The copy keeps the user stacks of PARENT's other threads, so
+     their slots stay taken. */
+  lock_acquire (&parent->process_lock);
+  t->stack_slots = parent->stack_slots;
+  lock_release (&parent->process_lock);
+
+  return t->bin_file != NULL && page_table_copy (parent);
+}
+#else /* !VM */
+static bool
+fork_address_space (struct thread *parent UNUSED) 
+{
+  /* Copy-on-write sharing relies on the frame table, so fork()
+     is available only with virtual memory. */
+  return false;
+}
+#endif /* !VM */
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
    child of the calling process, or if process_wait() has already
    been successfully called for the given TID, returns -1
-   immediately, without waiting.
+   immediately, without waiting. */
+int
+process_wait (tid_t child_tid) 
+{
+  struct wait_status *ws;
+
+  ws = wait_status_take (&process_current ()->children, child_tid);
+  if (ws == NULL)
+    return -1;
+  sema_down (&ws->dead);
+  return wait_status_reap (ws);
+}
+
+/* Waits for any child of the running process to die, stores
+   its exit status into *EXIT_CODE, and returns its thread id.
+   If a child has already died without being waited for, returns
+   it without waiting.  Returns TID_ERROR immediately if the
+   process has no children left to wait for. */
+tid_t
+process_wait_any (int *exit_code) 
+{
+  struct thread *cur = process_current ();
+
+  /* Each child that dies ups CHILD_EXITED, so no death can slip
+     by between looking through the children and going to sleep.
+     A child that process_wait() reaped leaves its up behind,
+     which just costs an extra look. */
+  lock_acquire (&cur->process_lock);
+  while (!list_empty (&cur->children)) 
+    {
+      struct list_elem *e;
+
+      for (e = list_begin (&cur->children); e != list_end (&cur->children);
+           e = list_next (e)) 
+        {
+          struct wait_status *ws = list_entry (e, struct wait_status, elem);
+          if (sema_try_down (&ws->dead)) 
+            {
+              tid_t tid = ws->tid;
+              list_remove (&ws->elem);
+              lock_release (&cur->process_lock);
+              *exit_code = wait_status_reap (ws);
+              return tid;
+            }
+        }
+      lock_release (&cur->process_lock);
+      sema_down (&cur->child_exited);
+      lock_acquire (&cur->process_lock);
+    }
+  lock_release (&cur->process_lock);
+  return TID_ERROR;
+}
+
+/* Threads.
+
+   A process may run threads beyond its first, which share its
+   address space, its file descriptors, and its children: the
+   first thread's `struct thread' holds that state for all of
+   them, and each thread's `process' member points to it.  Each
+   other thread runs on a user stack of its own, in one of
+   THREAD_STACK_CNT slots below the first thread's stack, and
+   has a completion status in the process's list of threads, for
+   process_thread_join() to wait on as process_wait() does on a
+   child's.
+
+   A thread that calls thread_exit() leaves by itself, and the
+   process ends when its last thread leaves, with that thread's
+   exit code.  exit(), or being killed, ends the whole process at
+   once: the process is marked as exiting, which makes each of
+   its other threads exit in turn just before it would return to
+   user mode.  Either way, the first thread tears down the
+   process, after waiting for the others to leave.  A thread that
+   sleeps in the kernel indefinitely delays that until it wakes
+   up, so the process's handles are closed as soon as it starts
+   exiting, which wakes a thread blocked on a pipe whose other
+   end only the process holds. */
+
+/* Undoes thread_enter(), freeing user stack slot SLOT, and
+   wakes the process's first thread if it is waiting to tear
+   down the process and this was the last other thread.  The
+   caller may not touch the process's state afterward. */
+static void
+thread_leave (int slot) 
+{
+  struct thread *proc = process_current ();
+
+  lock_acquire (&proc->process_lock);
+  proc->stack_slots &= ~(1u << slot);
+  if (--proc->thread_cnt == 0)
+    cond_signal (&proc->threads_gone, &proc->process_lock);
+  lock_release (&proc->process_lock);
+}
+
+#ifdef VM
+/* Reserves a user stack slot for a new thread in the running
+   process and counts the thread, and returns the slot, or
+   returns -1 if the process is exiting or has no free slot. */
+static int
+thread_enter (void) 
+{
+  struct thread *proc = process_current ();
+  int slot = -1;
+  int i;
+
+  lock_acquire (&proc->process_lock);
+  if (!proc->exiting)
+    for (i = 0; i < THREAD_STACK_CNT; i++)
+      if ((proc->stack_slots & (1u << i)) == 0) 
+        {
+          proc->stack_slots |= 1u << i;
+          proc->thread_cnt++;
+          slot = i;
+          break;
+        }
+  lock_release (&proc->process_lock);
+  return slot;
+}
+
+/* Data passed from a thread calling thread_create() to the new
+   thread. */
+struct thread_info 
+  {
+    struct thread *process;             /* Process to run in. */
+    void (*eip) (void);                 /* Where to start running. */
+    void *esp;                          /* Initial stack pointer. */
+    struct wait_status *wait_status;    /* New thread's status. */
+    int stack_slot;                     /* New thread's user stack. */
+    struct semaphore started;           /* Upped when thread has started. */
+  };
+
+static thread_func start_thread NO_RETURN;
+
+/* Returns the top of user stack slot SLOT. */
+static uint8_t *
+stack_top (int slot) 
+{
+  return ((uint8_t *) PHYS_BASE
+          - (stack_page_limit + (size_t) slot * THREAD_STACK_PAGES) * PGSIZE);
+}
+
+/* Adds the pages of user stack slot SLOT to the running
+   process's supplemental page table, to be zeroed as they are
+   used.  Returns true if successful, false if the slot does not
+   fit in user memory, if some of its pages are already taken,
+   or if memory is not available. */
+static bool
+stack_allocate (int slot) 
+{
+  uint8_t *top;
+  size_t i;
+
+  if (stack_page_limit + (size_t) (slot + 1) * THREAD_STACK_PAGES
+      >= (uintptr_t) PHYS_BASE / PGSIZE)
+    return false;
+
+  top = stack_top (slot);
+  for (i = 1; i <= THREAD_STACK_PAGES; i++)
+    if (page_allocate (top - i * PGSIZE, true) == NULL) 
+      {
+        while (--i > 0)
+          page_deallocate (top - i * PGSIZE);
+        return false;
+      }
+  return true;
+}
+
+/* Removes the pages of user stack slot SLOT from the running
+   process's supplemental page table. */
+static void
+stack_deallocate (int slot) 
+{
+  uint8_t *top = stack_top (slot);
+  size_t i;
+
+  for (i = 1; i <= THREAD_STACK_PAGES; i++)
+    page_deallocate (top - i * PGSIZE);
+}
+
+/* Starts a new thread in the running process, which runs in
+   user mode from EIP, on a stack of its own that holds ARG1 and
+   ARG2 above a null return address, as if EIP were a function
+   called with them.  Returns the new thread's id, or TID_ERROR
+   if the process is exiting, already has THREAD_STACK_CNT other
+   threads, or if memory is not available. */
+tid_t
+process_thread_create (void (*eip) (void), void *arg1, void *arg2) 
+{
+  void *frame[3] = {NULL, arg1, arg2};
+  struct thread_info ti;
+  tid_t tid;
+
+  ti.stack_slot = thread_enter ();
+  if (ti.stack_slot < 0)
+    return TID_ERROR;
+  ti.process = process_current ();
+  ti.eip = eip;
+  ti.esp = stack_top (ti.stack_slot) - sizeof frame;
+  sema_init (&ti.started, 0);
+
+  ti.wait_status = wait_status_create ();
+  if (ti.wait_status == NULL)
+    goto no_status;
+  ti.wait_status->parent = NULL;
+  if (!stack_allocate (ti.stack_slot))
+    goto no_stack;
+  if (!copy_to_user (ti.esp, frame, sizeof frame))
+    goto no_thread;
+
+  tid = thread_create (ti.process->name, PRI_DEFAULT, start_thread, &ti);
+  if (tid == TID_ERROR)
+    goto no_thread;
+  sema_down (&ti.started);
+
+  ti.wait_status->tid = tid;
+  lock_acquire (&ti.process->process_lock);
+  list_push_back (&ti.process->threads, &ti.wait_status->elem);
+  lock_release (&ti.process->process_lock);
+  return tid;
+
+ no_thread:
+  stack_deallocate (ti.stack_slot);
+ no_stack:
+  free (ti.wait_status);
+ no_status:
+  thread_leave (ti.stack_slot);
+  return TID_ERROR;
+}
+
+/* A thread function that joins the process in TI_ and starts
+   running in user mode where TI_ says. */
+static void
+start_thread (void *ti_) 
+{
+  struct thread_info *ti = ti_;
+  struct thread *t = thread_current ();
+  struct intr_frame if_;
 
-   This function will be implemented in problem 2-2.  For now, it
-   does nothing. */
+  t->process = ti->process;
+  t->pagedir = ti->process->pagedir;
+  t->wait_status = ti->wait_status;
+  t->stack_slot = ti->stack_slot;
+  process_activate ();
+
+  memset (&if_, 0, sizeof if_);
+  if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
+  if_.cs = SEL_UCSEG;
+  if_.eflags = FLAG_IF | FLAG_MBS;
+  if_.eip = ti->eip;
+  if_.esp = ti->esp;
+
+  /* TI is on the creating thread's stack, which it may leave as
+     soon as it is woken. */
+  sema_up (&ti->started);
+
+  /* Return to user mode, as start_process() does. */
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+#else /* !VM */
+tid_t
+process_thread_create (void (*eip) (void) UNUSED, void *arg1 UNUSED,
+                       void *arg2 UNUSED) 
+{
+  /* Each thread's user stack is made of pages that are brought
+     in on demand, so threads are available only with virtual
+     memory. */
+  return TID_ERROR;
+}
+#endif /* !VM */
+
+/* Waits for thread TID of the running process to leave and
+   returns its exit code, which is -1 if it was killed.  Returns
+   -1 immediately if TID is the running thread or the process's
+   first thread, if it is not a thread of the running process,
+   or if it has already been joined. */
 int
-process_wait (tid_t child_tid UNUSED) 
+process_thread_join (tid_t tid) 
+{
+  struct wait_status *ws;
+
+  if (tid == thread_current ()->tid)
+    return -1;
+  ws = wait_status_take (&process_current ()->threads, tid);
+  if (ws == NULL)
+    return -1;
+  sema_down (&ws->dead);
+  return wait_status_reap (ws);
+}
+
+/* Makes the running thread leave its process with exit code
+   STATUS, leaving the process's other threads running. */
+void
+process_thread_exit (int status) 
 {
-  return -1;
+  struct thread *cur = thread_current ();
+  struct thread *proc = cur->process;
+
+  cur->exit_code = status;
+  lock_acquire (&proc->process_lock);
+  cur->thread_exited = true;
+  lock_release (&proc->process_lock);
+  thread_exit ();
+}
+
+/* Returns true if the running thread's process is exiting, in
+   which case the thread must exit rather than return to user
+   mode. */
+bool
+process_exiting (void) 
+{
+  return thread_current ()->process->exiting;
+}
+
+/* Makes the running thread's process exit with the thread's
+   exit code, unless it is exiting already.  Its other threads
+   leave the next time they would return to user mode.  Those
+   blocked reading or writing a pipe whose other end only the
+   process holds could never get there, so its handles are
+   closed here, rather than after they are gone. */
+static void
+start_exiting (void) 
+{
+  struct thread *cur = thread_current ();
+  struct thread *proc = cur->process;
+  bool exiting;
+
+  lock_acquire (&proc->process_lock);
+  exiting = proc->exiting;
+  if (!exiting) 
+    {
+      proc->exiting = true;
+      proc->exit_code = cur->exit_code;
+    }
+  lock_release (&proc->process_lock);
+
+  if (!exiting)
+    syscall_close_handles ();
+}
+
+/* Records the running thread's exit in its completion status,
+   waking its parent if it is a process that is waiting, and
+   lets go of the statuses of its own children and threads,
+   which no one can wait for any longer. */
+static void
+exit_wait_statuses (void) 
+{
+  struct thread *cur = thread_current ();
+  struct wait_status *ws = cur->wait_status;
+
+  while (!list_empty (&cur->children)) 
+    wait_status_release (list_entry (list_pop_front (&cur->children),
+                                     struct wait_status, elem));
+  while (!list_empty (&cur->threads)) 
+    wait_status_release (list_entry (list_pop_front (&cur->threads),
+                                     struct wait_status, elem));
+
+  if (ws != NULL) 
+    {
+      /* The parent cannot finish exiting, and so its thread
+         stays valid, while we hold WS's lock with REF_CNT 2. */
+      ws->exit_code = cur->exit_code;
+      lock_acquire (&ws->lock);
+      sema_up (&ws->dead);
+      if (ws->ref_cnt == 2 && ws->parent != NULL)
+        sema_up (&ws->parent->child_exited);
+      lock_release (&ws->lock);
+      wait_status_release (ws);
+      cur->wait_status = NULL;
+    }
+}
+
+/* Frees the resources of the running thread, one that its
+   process created beyond its first.  If the thread is leaving
+   by exit() or being killed, the process exits with the
+   thread's exit code.  If it called thread_exit() after the
+   first thread did, its exit code becomes the process's, until
+   another thread leaves. */
+static void
+exit_thread (void) 
+{
+  struct thread *cur = thread_current ();
+  struct thread *proc = cur->process;
+
+  lock_acquire (&proc->process_lock);
+  if (!proc->exiting && proc->thread_exited)
+    proc->exit_code = cur->exit_code;
+  lock_release (&proc->process_lock);
+  if (!cur->thread_exited)
+    start_exiting ();
+
+  syscall_exit ();
+#ifdef VM
+  stack_deallocate (cur->stack_slot);
+#endif
+
+  /* The first thread destroys the page directory only after
+     thread_leave(), so stop using it first. */
+  cur->pagedir = NULL;
+  pagedir_activate (NULL);
+
+  exit_wait_statuses ();
+  thread_leave (cur->stack_slot);
 }
 
 /* Free the current process's resources. */
@@ -98,6 +789,35 @@ process_exit (void)
   struct thread *cur = thread_current ();
   uint32_t *pd;
 
+  if (cur->process != cur) 
+    {
+      exit_thread ();
+      return;
+    }
+
+  if (cur->pagedir != NULL) 
+    {
+      /* Unless only this thread is leaving, take the others
+         along, and wait until they are gone either way. */
+      if (!cur->thread_exited)
+        start_exiting ();
+      lock_acquire (&cur->process_lock);
+      while (cur->thread_cnt > 0)
+        cond_wait (&cur->threads_gone, &cur->process_lock);
+      lock_release (&cur->process_lock);
+
+      printf ("%s: exit(%d)\n", cur->name, cur->exit_code);
+    }
+
+  /* Close open files and write back memory-mapped files. */
+  syscall_exit ();
+
+#ifdef VM
+  /* Free the process's frames while its page directory still
+     exists. */
+  page_exit ();
+#endif
+
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
   pd = cur->pagedir;
@@ -114,6 +834,20 @@ process_exit (void)
       pagedir_activate (NULL);
       pagedir_destroy (pd);
     }
+
+  /* Close the executable only after its pages are gone, since
+     they may still be read from it until then. */
+  if (cur->bin_file != NULL) 
+    {
+      lock_acquire (&filesys_lock);
+      file_close (cur->bin_file);
+      lock_release (&filesys_lock);
+      cur->bin_file = NULL;
+    }
+
+  /* Report the exit last, so that by the time a waiting parent
+     wakes up, everything above has been released. */
+  exit_wait_statuses ();
 }
 
 /* Sets up the CPU for running user code in the current
@@ -124,8 +858,14 @@ process_activate (void)
 {
   struct thread *t = thread_current ();
 
-  /* Activate thread's page tables. */
-  pagedir_activate (t->pagedir);
+  /* Activate thread's page tables.  A kernel thread uses only
+     kernel mappings, which are the same in every page directory,
+     so it just keeps using whichever one is active, sparing the
+     TLB flush of a switch to the base page directory and back.
+     A process activates the base page directory itself before
+     destroying its own, so the active one is never stale. */
+  if (t->pagedir != NULL)
+    pagedir_activate (t->pagedir);
 
   /* Set thread's kernel stack for use in processing
      interrupts. */
@@ -195,41 +935,133 @@ struct Elf32_Phdr
 #define PF_W 2          /* Writable. */
 #define PF_R 4          /* Readable. */
 
-static bool setup_stack (void **esp);
+static bool setup_stack (const char *cmd_line, void **esp);
 static bool validate_segment (const struct Elf32_Phdr *, struct file *);
 static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
                           uint32_t read_bytes, uint32_t zero_bytes,
                           bool writable);
 
-/* Loads an ELF executable from FILE_NAME into the current thread.
-   Stores the executable's entry point into *EIP
-   and its initial stack pointer into *ESP.
-   Returns true if successful, false otherwise. */
-bool
-load (const char *file_name, void (**eip) (void), void **esp) 
+/* A loadable segment of an executable, in the terms that
+   load_segment() takes. */
+struct segment
+  {
+    uint32_t file_page;         /* Page-aligned offset in file. */
+    uint32_t mem_page;          /* Page-aligned user virtual address. */
+    uint32_t read_bytes;        /* Bytes to read from file. */
+    uint32_t zero_bytes;        /* Bytes to zero after those. */
+    bool writable;              /* Writable by the process? */
+  };
+
+/* The layout of an executable, read from its ELF headers and
+   validated.
+
+   Running a program again, perhaps many times in a row, finds
+   its layout in the image cache instead of reading and checking
+   the headers again.  An image holds its executable's inode
+   open, so that the inode and its generation stay the same
+   from one run to the next even when nothing else has the file
+   open; that also lets the frames that hold the program's text
+   stay in the share table between runs, so that running it again
+   need not read the text either.  An image is good only as long
+   as the inode's generation matches, that is, until the
+   executable is written.
+
+   The image cache holds the IMAGE_CACHE_MAX most recently run
+   executables, most recent first, and is protected by
+   filesys_lock.  An executable's image leaves the cache as soon
+   as the executable is removed, so that its blocks are freed
+   once no process is running it. */
+struct image
+  {
+    struct list_elem elem;      /* Element in image cache. */
+    struct inode *inode;        /* Executable's inode, held open. */
+    unsigned long long generation; /* INODE's generation. */
+    uint32_t entry;             /* Entry point. */
+    size_t seg_cnt;             /* Number of segments. */
+    struct segment segs[];      /* Loadable segments. */
+  };
+
+#define IMAGE_CACHE_MAX 8
+
+static struct list image_cache = LIST_INITIALIZER (image_cache);
+static size_t image_cnt;        /* Number of images in IMAGE_CACHE. */
+
+/* Removes IMAGE from the image cache and frees it. */
+static void
+image_drop (struct image *image) 
 {
-  struct thread *t = thread_current ();
-  struct Elf32_Ehdr ehdr;
-  struct file *file = NULL;
-  off_t file_ofs;
-  bool success = false;
-  int i;
+  list_remove (&image->elem);
+  image_cnt--;
+  inode_close (image->inode);
+  free (image);
+}
 
-  /* Allocate and activate page directory. */
-  t->pagedir = pagedir_create ();
-  if (t->pagedir == NULL) 
-    goto done;
-  process_activate ();
+/* Drops the images in the image cache whose executables have
+   been removed, or every image if ALL is true, letting go of
+   their inodes.  Called when a file is removed and when the
+   file system is shut down, with filesys_lock held if other
+   threads may be using the file system. */
+void
+process_drop_images (bool all) 
+{
+  struct list_elem *e, *next;
 
-  /* Open executable file. */
-  file = filesys_open (file_name);
-  if (file == NULL) 
+  for (e = list_begin (&image_cache); e != list_end (&image_cache);
+       e = next)
     {
-      printf ("load: %s: open failed\n", file_name);
-      goto done; 
+      struct image *image = list_entry (e, struct image, elem);
+      next = list_next (e);
+      if (all || inode_is_removed (image->inode))
+        image_drop (image);
+    }
+}
+
+/* Returns the cached image of executable FILE, if it is up to
+   date, moving it to the front of the cache, or a null pointer
+   otherwise. */
+static struct image *
+image_lookup (struct file *file) 
+{
+  struct inode *inode = file_get_inode (file);
+  struct list_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&filesys_lock));
+
+  for (e = list_begin (&image_cache); e != list_end (&image_cache);
+       e = list_next (e))
+    {
+      struct image *image = list_entry (e, struct image, elem);
+      if (image->inode == inode) 
+        {
+          if (image->generation != inode_generation (inode))
+            {
+              image_drop (image);
+              return NULL;
+            }
+          list_remove (&image->elem);
+          list_push_front (&image_cache, &image->elem);
+          return image;
+        }
     }
+  return NULL;
+}
+
+/* Reads the ELF headers of executable FILE, named FILE_NAME,
+   checks them, and returns its layout, entered in the image
+   cache.  Returns a null pointer if FILE is not a valid
+   executable or memory is not available. */
+static struct image *
+image_read (struct file *file, const char *file_name) 
+{
+  struct Elf32_Ehdr ehdr;
+  struct image *image;
+  off_t file_ofs;
+  int i;
+
+  ASSERT (lock_held_by_current_thread (&filesys_lock));
 
   /* Read and verify executable header. */
+  file_seek (file, 0);
   if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
       || memcmp (ehdr.e_ident, "\177ELF\1\1\1", 7)
       || ehdr.e_type != 2
@@ -239,9 +1071,16 @@ load (const char *file_name, void (**eip) (void), void **esp)
       || ehdr.e_phnum > 1024) 
     {
       printf ("load: %s: error loading executable\n", file_name);
-      goto done; 
+      return NULL;
     }
 
+  /* There can be no more segments than program headers. */
+  image = malloc (sizeof *image + ehdr.e_phnum * sizeof *image->segs);
+  if (image == NULL)
+    return NULL;
+  image->entry = ehdr.e_entry;
+  image->seg_cnt = 0;
+
   /* Read program headers. */
   file_ofs = ehdr.e_phoff;
   for (i = 0; i < ehdr.e_phnum; i++) 
@@ -249,11 +1088,11 @@ load (const char *file_name, void (**eip) (void), void **esp)
       struct Elf32_Phdr phdr;
 
       if (file_ofs < 0 || file_ofs > file_length (file))
-        goto done;
+        goto error;
       file_seek (file, file_ofs);
 
       if (file_read (file, &phdr, sizeof phdr) != sizeof phdr)
-        goto done;
+        goto error;
       file_ofs += sizeof phdr;
       switch (phdr.p_type) 
         {
@@ -267,58 +1106,148 @@ load (const char *file_name, void (**eip) (void), void **esp)
         case PT_DYNAMIC:
         case PT_INTERP:
         case PT_SHLIB:
-          goto done;
+          goto error;
         case PT_LOAD:
           if (validate_segment (&phdr, file)) 
             {
-              bool writable = (phdr.p_flags & PF_W) != 0;
-              uint32_t file_page = phdr.p_offset & ~PGMASK;
-              uint32_t mem_page = phdr.p_vaddr & ~PGMASK;
+              struct segment *seg = &image->segs[image->seg_cnt++];
               uint32_t page_offset = phdr.p_vaddr & PGMASK;
-              uint32_t read_bytes, zero_bytes;
+
+              seg->writable = (phdr.p_flags & PF_W) != 0;
+              seg->file_page = phdr.p_offset & ~PGMASK;
+              seg->mem_page = phdr.p_vaddr & ~PGMASK;
               if (phdr.p_filesz > 0)
                 {
                   /* Normal segment.
                      Read initial part from disk and zero the rest. */
-                  read_bytes = page_offset + phdr.p_filesz;
-                  zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz, PGSIZE)
-                                - read_bytes);
+                  seg->read_bytes = page_offset + phdr.p_filesz;
+                  seg->zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz,
+                                               PGSIZE)
+                                     - seg->read_bytes);
                 }
               else 
                 {
                   /* Entirely zero.
                      Don't read anything from disk. */
-                  read_bytes = 0;
-                  zero_bytes = ROUND_UP (page_offset + phdr.p_memsz, PGSIZE);
+                  seg->read_bytes = 0;
+                  seg->zero_bytes = ROUND_UP (page_offset + phdr.p_memsz,
+                                              PGSIZE);
                 }
-              if (!load_segment (file, file_page, (void *) mem_page,
-                                 read_bytes, zero_bytes, writable))
-                goto done;
             }
           else
-            goto done;
+            goto error;
           break;
         }
     }
 
-  /* Set up stack. */
-  if (!setup_stack (esp))
+  /* Enter the image in the cache, making room if necessary. */
+  if (image_cnt >= IMAGE_CACHE_MAX)
+    image_drop (list_entry (list_back (&image_cache), struct image, elem));
+  image->inode = inode_reopen (file_get_inode (file));
+  image->generation = inode_generation (image->inode);
+  list_push_front (&image_cache, &image->elem);
+  image_cnt++;
+  return image;
+
+ error:
+  free (image);
+  return NULL;
+}
+
+/* Loads an ELF executable named by the first word of CMD_LINE
+   into the current thread, with the words of CMD_LINE as its
+   arguments.  Stores the executable's entry point into *EIP
+   and its initial stack pointer into *ESP.
+   Returns true if successful, false otherwise. */
+bool
+load (const char *cmd_line, void (**eip) (void), void **esp) 
+{
+  struct thread *t = thread_current ();
+  char file_name[NAME_MAX + 2];
+  struct image *image;
+  struct file *file = NULL;
+  bool success = false;
+  size_t i;
+
+  /* Allocate and activate page directory. */
+  t->pagedir = pagedir_create ();
+  if (t->pagedir == NULL) 
+    goto done;
+  process_activate ();
+#ifdef VM
+  if (!page_table_create ())
+    goto done;
+#endif
+
+  /* Open executable file.  It stays open for as long as the
+     process runs, so that its pages can be loaded on demand. */
+  get_program_name (file_name, cmd_line, sizeof file_name);
+  lock_acquire (&filesys_lock);
+  file = filesys_open (file_name);
+  if (file == NULL) 
+    {
+      printf ("load: %s: open failed\n", file_name);
+      goto done; 
+    }
+  file_deny_write (file);
+
+  /* Find the executable's layout. */
+  image = image_lookup (file);
+  if (image == NULL)
+    image = image_read (file, file_name);
+  if (image == NULL)
     goto done;
 
+  /* Load segments. */
+  for (i = 0; i < image->seg_cnt; i++) 
+    {
+      const struct segment *seg = &image->segs[i];
+
+      if (!load_segment (file, seg->file_page, (void *) seg->mem_page,
+                         seg->read_bytes, seg->zero_bytes, seg->writable))
+        goto done;
+#ifdef VM
+      /* The heap starts above the highest segment. */
+      if ((uint8_t *) seg->mem_page + seg->read_bytes + seg->zero_bytes
+          > t->heap_start)
+        t->heap_start = ((uint8_t *) seg->mem_page
+                         + seg->read_bytes + seg->zero_bytes);
+#endif
+    }
+
+#ifdef VM
+  t->heap_brk = t->heap_start;
+#endif
+
   /* Start address. */
-  *eip = (void (*) (void)) ehdr.e_entry;
+  *eip = (void (*) (void)) image->entry;
+
+  /* Set up stack.  Getting a frame for it may evict a page that
+     must be written back to its file, so let go of the file
+     system first. */
+  lock_release (&filesys_lock);
+  if (!setup_stack (cmd_line, esp))
+    goto done;
 
   success = true;
 
  done:
   /* We arrive here whether the load is successful or not. */
-  file_close (file);
+  if (!lock_held_by_current_thread (&filesys_lock))
+    lock_acquire (&filesys_lock);
+  if (success)
+    t->bin_file = file;
+  else
+    file_close (file);
+  lock_release (&filesys_lock);
   return success;
 }
 
 /* load() helpers. */
 
+#ifndef VM
 static bool install_page (void *upage, void *kpage, bool writable);
+#endif
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -377,8 +1306,45 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
    The pages initialized by this function must be writable by the
    user process if WRITABLE is true, read-only otherwise.
 
+   With VM, nothing is read here.  Each page is only recorded in
+   the supplemental page table, to be read in or zeroed by the
+   page fault handler on first access.
+
    Return true if successful, false if a memory allocation error
    or disk read error occurs. */
+#ifdef VM
+static bool
+load_segment (struct file *file, off_t ofs, uint8_t *upage,
+              uint32_t read_bytes, uint32_t zero_bytes, bool writable) 
+{
+  ASSERT ((read_bytes + zero_bytes) % PGSIZE == 0);
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (ofs % PGSIZE == 0);
+
+  while (read_bytes > 0 || zero_bytes > 0) 
+    {
+      size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
+      size_t page_zero_bytes = PGSIZE - page_read_bytes;
+      struct page *p = page_allocate (upage, writable);
+      if (p == NULL)
+        return false;
+
+      if (page_read_bytes > 0) 
+        {
+          p->file = file;
+          p->file_offset = ofs;
+          p->file_bytes = page_read_bytes;
+        }
+
+      /* Advance. */
+      read_bytes -= page_read_bytes;
+      zero_bytes -= page_zero_bytes;
+      ofs += page_read_bytes;
+      upage += PGSIZE;
+    }
+  return true;
+}
+#else /* !VM */
 static bool
 load_segment (struct file *file, off_t ofs, uint8_t *upage,
               uint32_t read_bytes, uint32_t zero_bytes, bool writable) 
@@ -423,27 +1389,134 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
     }
   return true;
 }
+#endif /* !VM */
+
+/* Pushes the SIZE bytes in BUF onto the stack in KPAGE, whose
+   page-relative stack pointer is *OFS, and then adjusts *OFS
+   appropriately.  The bytes pushed are rounded to a 32-bit
+   boundary.
+
+   If successful, returns a pointer to the newly pushed object.
+   On failure, returns a null pointer. */
+static void *
+push (uint8_t *kpage, size_t *ofs, const void *buf, size_t size) 
+{
+  size_t padsize = ROUND_UP (size, sizeof (uint32_t));
+  if (*ofs < padsize)
+    return NULL;
+
+  *ofs -= padsize;
+  memcpy (kpage + *ofs + (padsize - size), buf, size);
+  return kpage + *ofs + (padsize - size);
+}
+
+/* Reverses the order of the CNT pointers in ARGV[]. */
+static void
+reverse (int cnt, char **argv) 
+{
+  for (; cnt > 1; cnt -= 2, argv++) 
+    {
+      char *tmp = argv[0];
+      argv[0] = argv[cnt - 1];
+      argv[cnt - 1] = tmp;
+    }
+}
 
-/* Create a minimal stack by mapping a zeroed page at the top of
-   user virtual memory. */
+/* Sets up command line arguments in KPAGE, which will be mapped
+   to UPAGE in user space.  The command line arguments are taken
+   from CMD_LINE, separated by spaces.  Sets *ESP to the initial
+   stack pointer for the process.  Returns true if successful,
+   false if the arguments do not fit in a page. */
+static bool
+init_cmd_line (uint8_t *kpage, uint8_t *upage, const char *cmd_line,
+               void **esp) 
+{
+  size_t ofs = PGSIZE;
+  char *const null = NULL;
+  char *cmd_line_copy;
+  char *karg, *saveptr;
+  int argc;
+  char **argv;
+
+  /* Push command line string. */
+  cmd_line_copy = push (kpage, &ofs, cmd_line, strlen (cmd_line) + 1);
+  if (cmd_line_copy == NULL)
+    return false;
+
+  if (push (kpage, &ofs, &null, sizeof null) == NULL)
+    return false;
+
+  /* Parse command line into arguments
+     and push them in reverse order. */
+  argc = 0;
+  for (karg = strtok_r (cmd_line_copy, " ", &saveptr); karg != NULL;
+       karg = strtok_r (NULL, " ", &saveptr))
+    {
+      void *uarg = upage + (karg - (char *) kpage);
+      if (push (kpage, &ofs, &uarg, sizeof uarg) == NULL)
+        return false;
+      argc++;
+    }
+
+  /* Reverse the order of the command line arguments. */
+  argv = (char **) (upage + ofs);
+  reverse (argc, (char **) (kpage + ofs));
+
+  /* Push argv, argc, "return address". */
+  if (push (kpage, &ofs, &argv, sizeof argv) == NULL
+      || push (kpage, &ofs, &argc, sizeof argc) == NULL
+      || push (kpage, &ofs, &null, sizeof null) == NULL)
+    return false;
+
+  /* Set initial stack pointer. */
+  *esp = upage + ofs;
+  return true;
+}
+
+/* Creates a minimal stack by mapping a page at the
+   top of user virtual memory.  Fills in the page using CMD_LINE
+   and sets *ESP to the stack pointer. */
+#ifdef VM
+static bool
+setup_stack (const char *cmd_line, void **esp) 
+{
+  uint8_t *upage = ((uint8_t *) PHYS_BASE) - PGSIZE;
+  struct page *p;
+  bool success;
+
+  p = page_allocate (upage, true);
+  if (p == NULL || page_lock (upage, true) == NULL)
+    return false;
+
+  /* The arguments are written through the kernel's mapping of
+     the frame, which does not set the user page's dirty bit, so
+     set it by hand to keep them from being discarded. */
+  success = init_cmd_line (p->frame->base, upage, cmd_line, esp);
+  pagedir_set_dirty (thread_current ()->pagedir, upage, true);
+  page_unlock (p);
+  return success;
+}
+#else /* !VM */
 static bool
-setup_stack (void **esp) 
+setup_stack (const char *cmd_line, void **esp) 
 {
   uint8_t *kpage;
+  uint8_t *upage = ((uint8_t *) PHYS_BASE) - PGSIZE;
   bool success = false;
 
   kpage = palloc_get_page (PAL_USER | PAL_ZERO);
   if (kpage != NULL) 
     {
-      success = install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true);
-      if (success)
-        *esp = PHYS_BASE;
+      if (install_page (upage, kpage, true))
+        success = init_cmd_line (kpage, upage, cmd_line, esp);
       else
         palloc_free_page (kpage);
     }
   return success;
 }
+#endif /* !VM */
 
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -463,3 +1536,4 @@ install_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
+#endif /* !VM */
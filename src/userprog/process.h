@@ -1,11 +1,23 @@
 #ifndef USERPROG_PROCESS_H
 #define USERPROG_PROCESS_H
 
+#include <debug.h>
 #include "threads/thread.h"
 
+struct intr_frame;
+
 tid_t process_execute (const char *file_name);
+tid_t process_fork (const struct intr_frame *);
 int process_wait (tid_t);
+tid_t process_wait_any (int *exit_code);
 void process_exit (void);
 void process_activate (void);
 
+struct thread *process_current (void);
+tid_t process_thread_create (void (*eip) (void), void *arg1, void *arg2);
+int process_thread_join (tid_t);
+void process_thread_exit (int status) NO_RETURN;
+bool process_exiting (void);
+void process_drop_images (bool all);
+
 #endif /* userprog/process.h */
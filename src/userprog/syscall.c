@@ -1,20 +1,1922 @@
 #include "userprog/syscall.h"
+#include <bitmap.h>
+#include <limits.h>
+#include <round.h>
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
+#include "userprog/gdt.h"
+#include "userprog/pagedir.h"
+#include "userprog/pipe.h"
+#include "userprog/process.h"
+#include "userprog/tss.h"
+#include "userprog/usercopy.h"
+#include "devices/input.h"
+#include "devices/shutdown.h"
+#include "filesys/file.h"
+#include "filesys/filesys.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/page.h"
+#include "vm/shm.h"
+#endif
 
-static void syscall_handler (struct intr_frame *);
+void syscall_handler (struct intr_frame *);
+static bool cpu_has_sep (void);
+static void copy_in (void *, const void *, size_t);
+static void copy_out (void *, const void *, size_t);
+static char *copy_in_string (const char *);
+static void release_held_fds (void);
+
+static int sys_halt (void);
+static int sys_exit (int status);
+static int sys_exec (const char *ufile);
+static int sys_wait (tid_t);
+static int sys_create (const char *ufile, unsigned initial_size);
+static int sys_remove (const char *ufile);
+static int sys_open (const char *ufile);
+static int sys_filesize (int handle);
+static int sys_read (int handle, void *udst_, unsigned size);
+static int sys_write (int handle, void *usrc_, unsigned size);
+static int sys_seek (int handle, unsigned position);
+static int sys_tell (int handle);
+static int sys_close (int handle);
+static int sys_mmap (int handle, void *addr);
+static int sys_munmap (int mapping);
+static int sys_fork (struct intr_frame *);
+static int sys_madvise (void *addr, unsigned length, int advice);
+static int sys_sbrk (int increment);
+static int sys_mmap_anon (void *addr, unsigned length);
+static int sys_dup (int handle);
+static int sys_dup2 (int handle, int new_handle);
+static int sys_fcntl (int handle, int cmd, int arg);
+static int sys_readv (int handle, const struct iovec *, int cnt);
+static int sys_writev (int handle, const struct iovec *, int cnt);
+static int sys_pread (int handle, void *udst, unsigned size, int ofs);
+static int sys_pwrite (int handle, void *usrc, unsigned size, int ofs);
+static int sys_io_setup (struct io_ring *);
+static int sys_io_enter (unsigned to_submit);
+static int sys_waitany (int *ustatus);
+static int sys_pipe (int *uhandles);
+static int sys_splice (int in_handle, int out_handle, unsigned size);
+static int sys_shm_map (const char *uname, unsigned size, void *addr);
+static int sys_shm_unmap (void *addr);
+static int sys_thread_create (void (*entry) (void), void *func, void *aux);
+static int sys_thread_join (tid_t);
+static int sys_thread_exit (int status);
+
+/* A system call. */
+typedef int syscall_function (int, int, int, int, int);
+struct syscall
+  {
+    size_t arg_cnt;             /* Number of arguments. */
+    syscall_function *func;     /* Implementation. */
+  };
+
+/* Table of system calls, indexed by SYS_* number.  Each function
+   is called with its arguments, followed by a pointer to the
+   interrupt frame for the calls that need it.  A null function
+   is a call that this kernel does not implement.  The detour
+   through void (*) (void) tells GCC that the differing function
+   types are intended. */
+#define SYSCALL(NUMBER, ARG_CNT, FUNC) \
+  [NUMBER] = {ARG_CNT, (syscall_function *) (void (*) (void)) FUNC}
+static const struct syscall syscall_table[] =
+  {
+    SYSCALL (SYS_HALT, 0, sys_halt),
+    SYSCALL (SYS_EXIT, 1, sys_exit),
+    SYSCALL (SYS_EXEC, 1, sys_exec),
+    SYSCALL (SYS_WAIT, 1, sys_wait),
+    SYSCALL (SYS_CREATE, 2, sys_create),
+    SYSCALL (SYS_REMOVE, 1, sys_remove),
+    SYSCALL (SYS_OPEN, 1, sys_open),
+    SYSCALL (SYS_FILESIZE, 1, sys_filesize),
+    SYSCALL (SYS_READ, 3, sys_read),
+    SYSCALL (SYS_WRITE, 3, sys_write),
+    SYSCALL (SYS_SEEK, 2, sys_seek),
+    SYSCALL (SYS_TELL, 1, sys_tell),
+    SYSCALL (SYS_CLOSE, 1, sys_close),
+    SYSCALL (SYS_MMAP, 2, sys_mmap),
+    SYSCALL (SYS_MUNMAP, 1, sys_munmap),
+    SYSCALL (SYS_FORK, 0, sys_fork),
+    SYSCALL (SYS_MADVISE, 3, sys_madvise),
+    SYSCALL (SYS_SBRK, 1, sys_sbrk),
+    SYSCALL (SYS_MMAP_ANON, 2, sys_mmap_anon),
+    SYSCALL (SYS_DUP, 1, sys_dup),
+    SYSCALL (SYS_DUP2, 2, sys_dup2),
+    SYSCALL (SYS_FCNTL, 3, sys_fcntl),
+    SYSCALL (SYS_READV, 3, sys_readv),
+    SYSCALL (SYS_WRITEV, 3, sys_writev),
+    SYSCALL (SYS_PREAD, 4, sys_pread),
+    SYSCALL (SYS_PWRITE, 4, sys_pwrite),
+    SYSCALL (SYS_IO_SETUP, 1, sys_io_setup),
+    SYSCALL (SYS_IO_ENTER, 1, sys_io_enter),
+    SYSCALL (SYS_WAITANY, 1, sys_waitany),
+    SYSCALL (SYS_PIPE, 1, sys_pipe),
+    SYSCALL (SYS_SPLICE, 3, sys_splice),
+    SYSCALL (SYS_SHM_MAP, 3, sys_shm_map),
+    SYSCALL (SYS_SHM_UNMAP, 1, sys_shm_unmap),
+    SYSCALL (SYS_THREAD_CREATE, 3, sys_thread_create),
+    SYSCALL (SYS_THREAD_JOIN, 1, sys_thread_join),
+    SYSCALL (SYS_THREAD_EXIT, 1, sys_thread_exit),
+  };
+
+/* Model-specific registers that configure SYSENTER.
+   See [IA32-v3a] 4.8.7 "Performing Fast Calls to System
+   Procedures with the SYSENTER and SYSEXIT Instructions". */
+#define MSR_SYSENTER_CS  0x174  /* Kernel code selector. */
+#define MSR_SYSENTER_ESP 0x175  /* Kernel stack pointer. */
+#define MSR_SYSENTER_EIP 0x176  /* Kernel entry point. */
+
+/* CPUID feature flag for SYSENTER and SYSEXIT. */
+#define CPUID_SEP (1u << 11)
+
+/* Writes VALUE to model-specific register MSR. */
+static inline void
+wrmsr (uint32_t msr, uint64_t value)
+{
+  asm volatile ("wrmsr" : : "c" (msr), "A" (value));
+}
 
 void
 syscall_init (void) 
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
+
+  /* Also accept system calls through SYSENTER, if the CPU
+     supports it.  SYSENTER loads the stack pointer with the end
+     of the TSS's page, because the MSR can't track each thread's
+     kernel stack; sysenter_entry then fetches that from the TSS.
+     SYSEXIT returns to the user selectors at fixed offsets from
+     the kernel code selector, which our GDT layout matches. */
+  if (cpu_has_sep ())
+    {
+      ASSERT (SEL_UCSEG == ((SEL_KCSEG + 16) | 3));
+      ASSERT (SEL_UDSEG == ((SEL_KCSEG + 24) | 3));
+      wrmsr (MSR_SYSENTER_CS, SEL_KCSEG);
+      wrmsr (MSR_SYSENTER_ESP, (uintptr_t) tss_get () + PGSIZE);
+      wrmsr (MSR_SYSENTER_EIP, (uintptr_t) sysenter_entry);
+    }
+}
+
+/* Returns true if the CPU supports SYSENTER and SYSEXIT, false
+   otherwise.  The earliest Pentium Pro steppings report the
+   feature without implementing it.  See [IA32-v2b] "SYSENTER". */
+static bool
+cpu_has_sep (void)
+{
+  uint32_t eax, ebx, ecx, edx;
+  unsigned family, model, stepping;
+
+  asm ("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (1));
+  family = (eax >> 8) & 0xf;
+  model = (eax >> 4) & 0xf;
+  stepping = eax & 0xf;
+  return ((edx & CPUID_SEP) != 0
+          && !(family == 6 && model < 3 && stepping < 3));
 }
 
+/* System call handler, for both "int $0x30" and SYSENTER. */
+void
+syscall_handler (struct intr_frame *f)
+{
+  const struct syscall *sc;
+  unsigned call_nr;
+  int args[5];
+
+#ifdef VM
+  /* Save the user's stack pointer, for page faults taken while
+     handling the call. */
+  thread_current ()->user_esp = f->esp;
+#endif
+
+  /* Get the system call. */
+  copy_in (&call_nr, f->esp, sizeof call_nr);
+  if (call_nr >= sizeof syscall_table / sizeof *syscall_table
+      || syscall_table[call_nr].func == NULL)
+    thread_exit ();
+  sc = syscall_table + call_nr;
+
+  /* Get the system call arguments, followed by the interrupt
+     frame. */
+  ASSERT (sc->arg_cnt < sizeof args / sizeof *args);
+  memset (args, 0, sizeof args);
+  copy_in (args, (uint32_t *) f->esp + 1, sizeof *args * sc->arg_cnt);
+  args[sc->arg_cnt] = (int) f;
+
+  /* Execute the system call,
+     and set the return value. */
+  f->eax = sc->func (args[0], args[1], args[2], args[3], args[4]);
+
+  /* Let go of the file descriptors that the call used.  If
+     another thread is taking the process down, go along with it
+     rather than return to user mode. */
+  release_held_fds ();
+  if (process_exiting ())
+    thread_exit ();
+}
+
+/* Copies SIZE bytes from user address USRC to kernel address
+   DST.  Call thread_exit() if any of the user accesses are
+   invalid. */
 static void
-syscall_handler (struct intr_frame *f UNUSED) 
+copy_in (void *dst, const void *usrc, size_t size)
 {
-  printf ("system call!\n");
+  if (!copy_from_user (dst, usrc, size))
+    thread_exit ();
+}
+
+/* Copies SIZE bytes from kernel address SRC to user address
+   UDST.  Call thread_exit() if any of the user accesses are
+   invalid. */
+static void
+copy_out (void *udst, const void *src, size_t size)
+{
+  if (!copy_to_user (udst, src, size))
+    thread_exit ();
+}
+
+/* Creates a copy of user string US in kernel memory and returns
+   it as a page that must be freed with palloc_free_page().
+   Truncates the string at PGSIZE bytes in size.  Call
+   thread_exit() if any of the user accesses are invalid. */
+static char *
+copy_in_string (const char *us)
+{
+  char *ks;
+
+  ks = palloc_get_page (0);
+  if (ks == NULL)
+    thread_exit ();
+
+  if (strncpy_from_user (ks, us, PGSIZE) < 0)
+    {
+      palloc_free_page (ks);
+      thread_exit ();
+    }
+  ks[PGSIZE - 1] = '\0';
+  return ks;
+}
+
+/* Makes the user page containing UADDR safe for the kernel to
+   access while it holds the file system lock, which the page
+   fault handler may need: that is, brings it into memory and
+   pins it there.  If WILL_WRITE is true, the page must be
+   writable.  Call thread_exit() if UADDR is invalid.  Returns
+   the page to pass to unlock_user() to undo this. */
+static struct page *
+lock_user (const void *uaddr, bool will_write)
+{
+#ifdef VM
+  struct page *p = page_lock (uaddr, will_write);
+  if (p == NULL)
+    thread_exit ();
+  return p;
+#else
+  if (!is_user_vaddr (uaddr)
+      || pagedir_get_page (thread_current ()->pagedir, uaddr) == NULL)
+    thread_exit ();
+  (void) will_write;
+  return NULL;
+#endif
+}
+
+/* Unlocks user page P, which must have been locked with
+   lock_user(). */
+static void
+unlock_user (struct page *p UNUSED)
+{
+#ifdef VM
+  page_unlock (p);
+#endif
+}
+
+/* Halt system call. */
+static int
+sys_halt (void)
+{
+  shutdown_power_off ();
+}
+
+/* Exit system call. */
+static int
+sys_exit (int exit_code)
+{
+  thread_current ()->exit_code = exit_code;
   thread_exit ();
+  NOT_REACHED ();
+}
+
+/* Exec system call. */
+static int
+sys_exec (const char *ufile)
+{
+  tid_t tid;
+  char *kfile = copy_in_string (ufile);
+
+  tid = process_execute (kfile);
+  palloc_free_page (kfile);
+
+  return tid;
+}
+
+/* Wait system call. */
+static int
+sys_wait (tid_t child)
+{
+  return process_wait (child);
+}
+
+/* Waitany system call.  Stores the exit status of the child
+   that died into *USTATUS, unless USTATUS is null. */
+static int
+sys_waitany (int *ustatus)
+{
+  int exit_code;
+  tid_t tid = process_wait_any (&exit_code);
+
+  if (tid != TID_ERROR && ustatus != NULL)
+    copy_out (ustatus, &exit_code, sizeof exit_code);
+  return tid;
+}
+
+/* Create system call. */
+static int
+sys_create (const char *ufile, unsigned initial_size)
+{
+  char *kfile = copy_in_string (ufile);
+  bool ok;
+
+  lock_acquire (&filesys_lock);
+  ok = filesys_create (kfile, initial_size);
+  lock_release (&filesys_lock);
+
+  palloc_free_page (kfile);
+
+  return ok;
+}
+
+/* Remove system call. */
+static int
+sys_remove (const char *ufile)
+{
+  char *kfile = copy_in_string (ufile);
+  bool ok;
+
+  lock_acquire (&filesys_lock);
+  ok = filesys_remove (kfile);
+  lock_release (&filesys_lock);
+
+  palloc_free_page (kfile);
+
+  return ok;
+}
+
+/* An open file or pipe end, shared by the handles that dup(),
+   dup2(), fork(), and exec() copy from one another, which
+   therefore also share its file position.
+
+   A process's table of handles is shared by its threads and
+   protected by filesys_lock.  A thread's system call holds a
+   reference to each file descriptor that it looks up, so that
+   another thread closing the handle meanwhile does not free it
+   from under the call. */
+struct file_descriptor
+  {
+    struct file *file;          /* File, or null if not a file. */
+    int ref_cnt;                /* Number of handles, under filesys_lock. */
+    struct pipe *pipe;          /* Pipe, or null if not a pipe end. */
+    bool writer;                /* Write end of PIPE? */
+  };
+
+/* The console, for reading and for writing.  A process started
+   by the kernel gets them as handles 0 and 1.  The references
+   they start out with keep them from ever being freed. */
+static struct file_descriptor console_in = {NULL, 1, NULL, false};
+static struct file_descriptor console_out = {NULL, 1, NULL, false};
+
+/* Minimum number of handles in a table of file descriptors. */
+#define FD_TABLE_MIN 16
+
+/* Enlarges T's table of file descriptors, if necessary, to
+   accommodate at least CNT handles.  Returns true if successful,
+   false if memory allocation fails.  The caller must hold
+   filesys_lock. */
+static bool
+grow_fds (struct thread *t, size_t cnt)
+{
+  struct file_descriptor **fds;
+  struct bitmap *map, *cloexec;
+  size_t new_cnt;
+  size_t i;
+
+  if (cnt <= t->fd_cnt)
+    return true;
+  for (new_cnt = t->fd_cnt > 0 ? t->fd_cnt : FD_TABLE_MIN;
+       new_cnt < cnt; new_cnt *= 2)
+    continue;
+
+  fds = calloc (new_cnt, sizeof *fds);
+  map = bitmap_create (new_cnt);
+  cloexec = bitmap_create (new_cnt);
+  if (fds == NULL || map == NULL || cloexec == NULL)
+    {
+      free (fds);
+      bitmap_destroy (map);
+      bitmap_destroy (cloexec);
+      return false;
+    }
+  for (i = 0; i < t->fd_cnt; i++)
+    {
+      fds[i] = t->fds[i];
+      bitmap_set (map, i, fds[i] != NULL);
+      bitmap_set (cloexec, i, bitmap_test (t->fd_cloexec, i));
+    }
+
+  free (t->fds);
+  bitmap_destroy (t->fd_map);
+  bitmap_destroy (t->fd_cloexec);
+  t->fds = fds;
+  t->fd_cnt = new_cnt;
+  t->fd_map = map;
+  t->fd_cloexec = cloexec;
+  return true;
+}
+
+/* Binds free handle HANDLE in T's table, which must be big
+   enough to hold it, to FD, with the close-on-exec flag set to
+   CLOEXEC.  The caller must hold filesys_lock. */
+static void
+bind_handle (struct thread *t, int handle, struct file_descriptor *fd,
+             bool cloexec)
+{
+  ASSERT (t->fds[handle] == NULL);
+  t->fds[handle] = fd;
+  bitmap_mark (t->fd_map, handle);
+  bitmap_set (t->fd_cloexec, handle, cloexec);
+  fd->ref_cnt++;
+}
+
+/* Binds the lowest-numbered free handle in the running process
+   to FD and returns it, or returns -1 if memory allocation
+   fails.  The caller must hold filesys_lock. */
+static int
+alloc_handle (struct file_descriptor *fd)
+{
+  struct thread *cur = process_current ();
+  size_t handle;
+
+  handle = cur->fd_map != NULL ? bitmap_scan (cur->fd_map, 0, 1, false)
+                               : BITMAP_ERROR;
+  if (handle == BITMAP_ERROR)
+    {
+      handle = cur->fd_cnt;
+      if (handle > INT_MAX || !grow_fds (cur, handle + 1))
+        return -1;
+    }
+  bind_handle (cur, handle, fd, false);
+  return handle;
+}
+
+/* Drops a reference to FD, freeing it when none remain.  The
+   caller must hold filesys_lock. */
+static void
+release_fd (struct file_descriptor *fd)
+{
+  ASSERT (fd->ref_cnt > 0);
+  if (--fd->ref_cnt == 0)
+    {
+      if (fd->pipe != NULL)
+        pipe_close (fd->pipe, fd->writer);
+      else
+        file_close (fd->file);
+      free (fd);
+    }
+}
+
+/* Frees handle HANDLE in T's table and drops its reference to
+   its file descriptor.  The caller must hold filesys_lock. */
+static void
+close_handle (struct thread *t, int handle)
+{
+  struct file_descriptor *fd = t->fds[handle];
+
+  t->fds[handle] = NULL;
+  bitmap_reset (t->fd_map, handle);
+  release_fd (fd);
+}
+
+/* Open system call. */
+static int
+sys_open (const char *ufile)
+{
+  char *kfile = copy_in_string (ufile);
+  struct file_descriptor *fd;
+  int handle = -1;
+
+  fd = malloc (sizeof *fd);
+  if (fd != NULL)
+    {
+      lock_acquire (&filesys_lock);
+      fd->file = filesys_open (kfile);
+      fd->ref_cnt = 0;
+      fd->pipe = NULL;
+      if (fd->file != NULL)
+        handle = alloc_handle (fd);
+      if (handle < 0)
+        {
+          file_close (fd->file);
+          free (fd);
+        }
+      lock_release (&filesys_lock);
+    }
+
+  palloc_free_page (kfile);
+  return handle;
+}
+
+/* Returns the file descriptor associated with the given handle,
+   or a null pointer if HANDLE is not associated with an open
+   file.  The caller must hold filesys_lock. */
+static struct file_descriptor *
+get_fd (int handle)
+{
+  struct thread *cur = process_current ();
+
+  return (unsigned) handle < cur->fd_cnt ? cur->fds[handle] : NULL;
+}
+
+/* Returns the file descriptor associated with the given handle,
+   holding a reference to it until the system call returns, or a
+   null pointer if HANDLE is not associated with an open file. */
+static struct file_descriptor *
+hold_fd (int handle)
+{
+  struct thread *cur = thread_current ();
+  struct file_descriptor *fd;
+
+  lock_acquire (&filesys_lock);
+  fd = get_fd (handle);
+  if (fd != NULL)
+    {
+      int i = cur->held_fds[0] == NULL ? 0 : 1;
+
+      ASSERT (cur->held_fds[i] == NULL);
+      cur->held_fds[i] = fd;
+      fd->ref_cnt++;
+    }
+  lock_release (&filesys_lock);
+  return fd;
+}
+
+/* Returns the file descriptor associated with the given handle,
+   holding a reference to it until the system call returns.
+   Terminates the process if HANDLE is not associated with an
+   open file. */
+static struct file_descriptor *
+lookup_fd (int handle)
+{
+  struct file_descriptor *fd = hold_fd (handle);
+
+  if (fd == NULL)
+    thread_exit ();
+  return fd;
+}
+
+/* Drops the references that lookup_fd() took for the running
+   thread's system call. */
+static void
+release_held_fds (void)
+{
+  struct thread *cur = thread_current ();
+  size_t i;
+
+  if (cur->held_fds[0] == NULL)
+    return;
+
+  lock_acquire (&filesys_lock);
+  for (i = 0; i < sizeof cur->held_fds / sizeof *cur->held_fds; i++)
+    if (cur->held_fds[i] != NULL)
+      {
+        release_fd (cur->held_fds[i]);
+        cur->held_fds[i] = NULL;
+      }
+  lock_release (&filesys_lock);
+}
+
+/* Filesize system call. */
+static int
+sys_filesize (int handle)
+{
+  struct file_descriptor *fd = lookup_fd (handle);
+  int size;
+
+  if (fd->file == NULL)
+    return -1;
+  lock_acquire (&filesys_lock);
+  size = file_length (fd->file);
+  lock_release (&filesys_lock);
+
+  return size;
+}
+
+/* A user buffer that data is moving to or from a pipe. */
+struct pipe_user
+  {
+    uint8_t *ubuf;              /* Next byte in user buffer. */
+    bool fault;                 /* Was part of the buffer invalid? */
+  };
+
+/* Pipe_drain() function that copies SIZE bytes from DATA to the
+   user buffer in PU_. */
+static int
+pipe_to_user (void *data, size_t size, void *pu_)
+{
+  struct pipe_user *pu = pu_;
+
+  if (!copy_to_user (pu->ubuf, data, size))
+    {
+      pu->fault = true;
+      return -1;
+    }
+  pu->ubuf += size;
+  return size;
+}
+
+/* Pipe_fill() function that copies SIZE bytes from the user
+   buffer in PU_ to DATA. */
+static int
+pipe_from_user (void *data, size_t size, void *pu_)
+{
+  struct pipe_user *pu = pu_;
+
+  if (!copy_from_user (data, pu->ubuf, size))
+    {
+      pu->fault = true;
+      return -1;
+    }
+  pu->ubuf += size;
+  return size;
+}
+
+/* Reads up to SIZE bytes from the pipe whose read end is FD into
+   user buffer UDST, waiting for data if there is none yet, and
+   returns the number of bytes read, which is 0 at end of file.
+   Terminates the process if UDST is invalid.  The data is copied
+   without the pipe locked, so the copy may fault in user pages,
+   but the process is only terminated after it lets go of the
+   pipe. */
+static int
+read_pipe (struct file_descriptor *fd, uint8_t *udst, size_t size)
+{
+  struct pipe_user pu;
+  int bytes_read;
+
+  pu.ubuf = udst;
+  pu.fault = false;
+  bytes_read = pipe_drain (fd->pipe, size, pipe_to_user, &pu);
+  if (pu.fault)
+    thread_exit ();
+  return bytes_read;
+}
+
+/* Writes SIZE bytes from user buffer USRC to the pipe whose
+   write end is FD, waiting for room as necessary, and returns the
+   number of bytes written, or -1 if the pipe's read end is
+   closed.  Terminates the process if USRC is invalid. */
+static int
+write_pipe (struct file_descriptor *fd, const uint8_t *usrc, size_t size)
+{
+  struct pipe_user pu;
+  int bytes_written;
+
+  pu.ubuf = (uint8_t *) usrc;
+  pu.fault = false;
+  bytes_written = pipe_fill (fd->pipe, size, pipe_from_user, &pu, true);
+  if (pu.fault)
+    thread_exit ();
+  return bytes_written;
+}
+
+/* Reads SIZE bytes from file descriptor FD into user buffer
+   UDST, starting at offset OFS in the file, or at the file's
+   position, advancing it, if OFS is negative.  Returns the
+   number of bytes read, or -1 if an error occurs before any
+   bytes are read.  Terminates the process if UDST is invalid. */
+static int
+read_fd (struct file_descriptor *fd, uint8_t *udst, size_t size, off_t ofs)
+{
+  int bytes_read = 0;
+
+  /* Handle pipe reads. */
+  if (fd->pipe != NULL)
+    return !fd->writer && ofs < 0 ? read_pipe (fd, udst, size) : -1;
+
+  /* Handle keyboard reads. */
+  if (fd == &console_in)
+    {
+      for (bytes_read = 0; (size_t) bytes_read < size; bytes_read++)
+        {
+          uint8_t c = input_getc ();
+          if (!copy_to_user (udst + bytes_read, &c, 1))
+            thread_exit ();
+        }
+      return bytes_read;
+    }
+  else if (fd->file == NULL)
+    return -1;
+
+  /* Handle all other reads. */
+  while (size > 0)
+    {
+      /* How much to read into this page? */
+      size_t page_left = PGSIZE - pg_ofs (udst);
+      size_t read_amt = size < page_left ? size : page_left;
+      struct page *p;
+      off_t retval;
+
+      /* Read from file into page. */
+      p = lock_user (udst, true);
+      lock_acquire (&filesys_lock);
+      if (ofs < 0)
+        retval = file_read (fd->file, udst, read_amt);
+      else
+        retval = file_read_at (fd->file, udst, read_amt, ofs + bytes_read);
+      lock_release (&filesys_lock);
+      unlock_user (p);
+
+      /* Handle return value. */
+      if (retval < 0)
+        {
+          if (bytes_read == 0)
+            bytes_read = -1;
+          break;
+        }
+      bytes_read += retval;
+      if (retval != (off_t) read_amt)
+        break;
+
+      /* Advance. */
+      udst += retval;
+      size -= retval;
+    }
+
+  return bytes_read;
+}
+
+/* Writes SIZE bytes from user buffer USRC to file descriptor FD,
+   starting at offset OFS in the file, or at the file's position,
+   advancing it, if OFS is negative.  Returns the number of bytes
+   written, or -1 if an error occurs before any bytes are
+   written.  Terminates the process if USRC is invalid. */
+static int
+write_fd (struct file_descriptor *fd, const uint8_t *usrc, size_t size,
+          off_t ofs)
+{
+  int bytes_written = 0;
+
+  if (fd->pipe != NULL)
+    return fd->writer && ofs < 0 ? write_pipe (fd, usrc, size) : -1;
+  if (fd == &console_in)
+    return -1;
+
+  while (size > 0)
+    {
+      /* How much bytes to write to this page? */
+      size_t page_left = PGSIZE - pg_ofs (usrc);
+      size_t write_amt = size < page_left ? size : page_left;
+      struct page *p;
+      off_t retval;
+
+      /* Write from page into file. */
+      p = lock_user (usrc, false);
+      lock_acquire (&filesys_lock);
+      if (fd == &console_out)
+        {
+          putbuf ((char *) usrc, write_amt);
+          retval = write_amt;
+        }
+      else if (ofs < 0)
+        retval = file_write (fd->file, usrc, write_amt);
+      else
+        retval = file_write_at (fd->file, usrc, write_amt,
+                                ofs + bytes_written);
+      lock_release (&filesys_lock);
+      unlock_user (p);
+
+      /* Handle return value. */
+      if (retval < 0)
+        {
+          if (bytes_written == 0)
+            bytes_written = -1;
+          break;
+        }
+      bytes_written += retval;
+
+      /* If it was a short write we're done. */
+      if (retval != (off_t) write_amt)
+        break;
+
+      /* Advance. */
+      usrc += retval;
+      size -= retval;
+    }
+
+  return bytes_written;
+}
+
+/* Read system call. */
+static int
+sys_read (int handle, void *udst, unsigned size)
+{
+  return read_fd (lookup_fd (handle), udst, size, -1);
+}
+
+/* Write system call. */
+static int
+sys_write (int handle, void *usrc, unsigned size)
+{
+  return write_fd (lookup_fd (handle), usrc, size, -1);
+}
+
+/* Reads SIZE bytes from offset OFS in FD's file into UDST,
+   without using or changing the file's position. */
+static int
+pread_fd (struct file_descriptor *fd, void *udst, unsigned size, int ofs)
+{
+  if (fd->file == NULL || ofs < 0)
+    return -1;
+  if (size > (unsigned) (INT_MAX - ofs))
+    size = INT_MAX - ofs;
+  return read_fd (fd, udst, size, ofs);
+}
+
+/* Writes SIZE bytes from USRC at offset OFS in FD's file,
+   without using or changing the file's position. */
+static int
+pwrite_fd (struct file_descriptor *fd, void *usrc, unsigned size, int ofs)
+{
+  if (fd->file == NULL || ofs < 0)
+    return -1;
+  if (size > (unsigned) (INT_MAX - ofs))
+    size = INT_MAX - ofs;
+  return write_fd (fd, usrc, size, ofs);
+}
+
+/* Pread system call.  Reads from offset OFS in the file, without
+   using or changing its position. */
+static int
+sys_pread (int handle, void *udst, unsigned size, int ofs)
+{
+  return pread_fd (lookup_fd (handle), udst, size, ofs);
+}
+
+/* Pwrite system call.  Writes at offset OFS in the file, without
+   using or changing its position. */
+static int
+sys_pwrite (int handle, void *usrc, unsigned size, int ofs)
+{
+  return pwrite_fd (lookup_fd (handle), usrc, size, ofs);
+}
+
+/* Maximum number of buffers passed to readv() or writev(). */
+#define IOV_MAX 1024
+
+/* Number of buffers for readv() or writev() that are copied to
+   the kernel stack, rather than to allocated memory. */
+#define IOV_STACK 8
+
+/* Copies CNT buffer descriptors from user array UIOV into
+   kernel memory and returns it.  The returned array is either
+   STACK_IOV, which must have room for IOV_STACK elements, or
+   allocated memory that must be freed with free().  Returns a
+   null pointer if CNT is out of range, the buffers add up to
+   more than INT_MAX bytes, or memory allocation fails.
+   Terminates the process if UIOV is invalid. */
+static struct iovec *
+copy_in_iov (const struct iovec *uiov, int cnt, struct iovec *stack_iov)
+{
+  struct iovec *iov;
+  size_t total = 0;
+  int i;
+
+  if (cnt < 0 || cnt > IOV_MAX)
+    return NULL;
+  iov = cnt <= IOV_STACK ? stack_iov : malloc (cnt * sizeof *iov);
+  if (iov == NULL)
+    return NULL;
+
+  copy_in (iov, uiov, cnt * sizeof *iov);
+  for (i = 0; i < cnt; i++)
+    {
+      if (iov[i].iov_len > INT_MAX - total)
+        {
+          if (iov != stack_iov)
+            free (iov);
+          return NULL;
+        }
+      total += iov[i].iov_len;
+    }
+  return iov;
+}
+
+/* Readv system call.  Reads into each of the CNT buffers
+   described by UIOV in turn, stopping at the first short read,
+   and returns the total number of bytes read. */
+static int
+sys_readv (int handle, const struct iovec *uiov, int cnt)
+{
+  struct file_descriptor *fd = lookup_fd (handle);
+  struct iovec stack_iov[IOV_STACK];
+  struct iovec *iov = copy_in_iov (uiov, cnt, stack_iov);
+  int bytes_read = 0;
+  int i;
+
+  if (iov == NULL)
+    return -1;
+  for (i = 0; i < cnt; i++)
+    {
+      int retval = read_fd (fd, iov[i].iov_base, iov[i].iov_len, -1);
+      if (retval < 0)
+        {
+          if (bytes_read == 0)
+            bytes_read = -1;
+          break;
+        }
+      bytes_read += retval;
+      if ((size_t) retval != iov[i].iov_len)
+        break;
+    }
+
+  if (iov != stack_iov)
+    free (iov);
+  return bytes_read;
+}
+
+/* Writev system call.  Writes each of the CNT buffers described
+   by UIOV in turn, stopping at the first short write, and
+   returns the total number of bytes written. */
+static int
+sys_writev (int handle, const struct iovec *uiov, int cnt)
+{
+  struct file_descriptor *fd = lookup_fd (handle);
+  struct iovec stack_iov[IOV_STACK];
+  struct iovec *iov = copy_in_iov (uiov, cnt, stack_iov);
+  int bytes_written = 0;
+  int i;
+
+  if (iov == NULL)
+    return -1;
+  for (i = 0; i < cnt; i++)
+    {
+      int retval = write_fd (fd, iov[i].iov_base, iov[i].iov_len, -1);
+      if (retval < 0)
+        {
+          if (bytes_written == 0)
+            bytes_written = -1;
+          break;
+        }
+      bytes_written += retval;
+      if ((size_t) retval != iov[i].iov_len)
+        break;
+    }
+
+  if (iov != stack_iov)
+    free (iov);
+  return bytes_written;
+}
+
+/* Seek system call. */
+static int
+sys_seek (int handle, unsigned position)
+{
+  struct file_descriptor *fd = lookup_fd (handle);
+
+  if (fd->file == NULL)
+    return 0;
+  lock_acquire (&filesys_lock);
+  if ((off_t) position >= 0)
+    file_seek (fd->file, position);
+  lock_release (&filesys_lock);
+
+  return 0;
+}
+
+/* Tell system call. */
+static int
+sys_tell (int handle)
+{
+  struct file_descriptor *fd = lookup_fd (handle);
+  unsigned position;
+
+  if (fd->file == NULL)
+    return -1;
+  lock_acquire (&filesys_lock);
+  position = file_tell (fd->file);
+  lock_release (&filesys_lock);
+
+  return position;
+}
+
+/* Closes HANDLE, unless another thread has closed it since it
+   was looked up. */
+static int
+close_fd (int handle)
+{
+  lock_acquire (&filesys_lock);
+  if (get_fd (handle) != NULL)
+    close_handle (process_current (), handle);
+  lock_release (&filesys_lock);
+
+  return 0;
+}
+
+/* Close system call. */
+static int
+sys_close (int handle)
+{
+  lookup_fd (handle);
+  return close_fd (handle);
+}
+
+/* Dup system call.  Returns the lowest free handle, made to
+   refer to the same file descriptor as HANDLE. */
+static int
+sys_dup (int handle)
+{
+  struct file_descriptor *fd = lookup_fd (handle);
+  int new_handle;
+
+  lock_acquire (&filesys_lock);
+  new_handle = alloc_handle (fd);
+  lock_release (&filesys_lock);
+
+  return new_handle;
+}
+
+/* Dup2 system call.  Makes NEW_HANDLE refer to the same file
+   descriptor as HANDLE, first closing NEW_HANDLE if it is open,
+   and returns NEW_HANDLE. */
+static int
+sys_dup2 (int handle, int new_handle)
+{
+  struct thread *cur = process_current ();
+  struct file_descriptor *fd = lookup_fd (handle);
+
+  if (new_handle == handle)
+    return new_handle;
+  if (new_handle < 0)
+    return -1;
+
+  lock_acquire (&filesys_lock);
+  if (!grow_fds (cur, (size_t) new_handle + 1))
+    {
+      lock_release (&filesys_lock);
+      return -1;
+    }
+  if (cur->fds[new_handle] != NULL)
+    close_handle (cur, new_handle);
+  bind_handle (cur, new_handle, fd, false);
+  lock_release (&filesys_lock);
+
+  return new_handle;
+}
+
+/* Fcntl system call.  F_GETFD returns HANDLE's flags, F_SETFD
+   sets them to ARG.  The only flag is FD_CLOEXEC, which makes
+   exec() leave HANDLE out of the new process.  Returns -1 for
+   any other command. */
+static int
+sys_fcntl (int handle, int cmd, int arg)
+{
+  struct thread *cur = process_current ();
+  int retval = -1;
+
+  lookup_fd (handle);
+  lock_acquire (&filesys_lock);
+  switch (cmd)
+    {
+    case F_GETFD:
+      retval = bitmap_test (cur->fd_cloexec, handle) ? FD_CLOEXEC : 0;
+      break;
+    case F_SETFD:
+      bitmap_set (cur->fd_cloexec, handle, (arg & FD_CLOEXEC) != 0);
+      retval = 0;
+      break;
+    }
+  lock_release (&filesys_lock);
+  return retval;
+}
+
+/* Number of pages in a pipe's buffer. */
+#define PIPE_PAGES 1
+
+/* Returns a new file descriptor for the write end of PIPE if
+   WRITER is true, otherwise for its read end, or a null pointer
+   if memory is not available. */
+static struct file_descriptor *
+new_pipe_fd (struct pipe *pipe, bool writer)
+{
+  struct file_descriptor *fd = malloc (sizeof *fd);
+  if (fd != NULL)
+    {
+      fd->file = NULL;
+      fd->ref_cnt = 0;
+      fd->pipe = pipe;
+      fd->writer = writer;
+    }
+  return fd;
+}
+
+/* Pipe system call.  Creates a pipe and stores handles for its
+   read end and its write end into UHANDLES[0] and UHANDLES[1].
+   Returns 0 if successful, -1 on failure. */
+static int
+sys_pipe (int *uhandles)
+{
+  struct pipe *pipe = pipe_create (PIPE_PAGES);
+  struct file_descriptor *fds[2] = {NULL, NULL};
+  int handles[2] = {-1, -1};
+  int i;
+
+  if (pipe == NULL)
+    return -1;
+  for (i = 0; i < 2; i++)
+    fds[i] = new_pipe_fd (pipe, i == 1);
+
+  lock_acquire (&filesys_lock);
+  for (i = 0; i < 2 && fds[i] != NULL; i++)
+    if ((handles[i] = alloc_handle (fds[i])) < 0)
+      break;
+  if (i < 2)
+    {
+      /* Closing a handle also closes its end of the pipe.  Close
+         the ends that did not get one by hand. */
+      for (i = 0; i < 2; i++)
+        if (handles[i] >= 0)
+          close_handle (process_current (), handles[i]);
+        else
+          {
+            pipe_close (pipe, i == 1);
+            free (fds[i]);
+          }
+      lock_release (&filesys_lock);
+      return -1;
+    }
+  lock_release (&filesys_lock);
+
+  copy_out (uhandles, handles, sizeof handles);
+  return 0;
+}
+
+/* Pipe_drain() function that writes SIZE bytes from DATA to the
+   file descriptor FD_, at its file position. */
+static int
+pipe_to_fd (void *data, size_t size, void *fd_)
+{
+  struct file_descriptor *fd = fd_;
+  int retval;
+
+  if (fd == &console_out)
+    {
+      putbuf (data, size);
+      return size;
+    }
+  else if (fd->file == NULL)
+    return -1;
+
+  lock_acquire (&filesys_lock);
+  retval = file_write (fd->file, data, size);
+  lock_release (&filesys_lock);
+  return retval;
+}
+
+/* Pipe_fill() function that reads SIZE bytes into DATA from the
+   file descriptor FD_, at its file position. */
+static int
+pipe_from_fd (void *data, size_t size, void *fd_)
+{
+  struct file_descriptor *fd = fd_;
+  int retval;
+
+  if (fd->file == NULL)
+    return -1;
+
+  lock_acquire (&filesys_lock);
+  retval = file_read (fd->file, data, size);
+  lock_release (&filesys_lock);
+  return retval;
+}
+
+/* Splice system call.  Moves up to SIZE bytes from the read end
+   of a pipe to a file, or from a file to the write end of a
+   pipe, directly between the pipe's buffer and the file, without
+   copying the data through user memory.  The file's position
+   advances.  Waits, as read() or write() would, only until some
+   data can be moved.  Returns the number of bytes moved, which
+   is 0 at end of file, or -1 on error.  Writing to the console
+   counts as writing to a file. */
+static int
+sys_splice (int in_handle, int out_handle, unsigned size)
+{
+  struct file_descriptor *in = lookup_fd (in_handle);
+  struct file_descriptor *out = lookup_fd (out_handle);
+
+  if (size > INT_MAX)
+    size = INT_MAX;
+  if (in->pipe != NULL && !in->writer && out->pipe == NULL)
+    return pipe_drain (in->pipe, size, pipe_to_fd, out);
+  else if (out->pipe != NULL && out->writer && in->pipe == NULL)
+    return pipe_fill (out->pipe, size, pipe_from_fd, in, false);
+  else
+    return -1;
+}
+
+/* I/O rings.
+
+   A process can batch its file operations through an I/O ring
+   in its own memory.  It registers the ring with io_setup(),
+   fills in entries in the ring's submission queue, and then
+   makes a single io_enter() call.  The kernel performs the
+   submitted operations in order, in the calling thread, and
+   posts the result of each one to the ring's completion queue,
+   so the cost of entering the kernel is paid once per batch
+   rather than once per operation.  Each side only advances its
+   own indexes: the kernel consumes submissions at sq_head and
+   produces completions at cq_tail. */
+
+/* Maximum number of entries in each of an I/O ring's queues. */
+#define IO_RING_MAX 4096
+
+/* Returns true if RING, as copied in from user memory, has a
+   valid size and consistent submission and completion queue
+   indexes. */
+static bool
+io_ring_valid (const struct io_ring *ring)
+{
+  return (ring->entries > 0
+          && ring->entries <= IO_RING_MAX
+          && (ring->entries & (ring->entries - 1)) == 0
+          && ring->sq_tail - ring->sq_head <= ring->entries
+          && ring->cq_tail - ring->cq_head <= ring->entries);
+}
+
+/* Performs the operation described by submission queue entry
+   SQE and returns its result.  An invalid handle makes the
+   operation fail, rather than terminating the process, even if
+   another thread closes the handle meanwhile: it is looked up
+   only once, and the descriptor found stays open until
+   io_enter() releases it. */
+static int
+io_perform (const struct io_sqe *sqe)
+{
+  struct file_descriptor *fd = NULL;
+
+  if (sqe->opcode != IORING_OP_NOP && sqe->opcode != IORING_OP_OPEN)
+    {
+      fd = hold_fd (sqe->fd);
+      if (fd == NULL)
+        return -1;
+    }
+
+  switch (sqe->opcode)
+    {
+    case IORING_OP_NOP:
+      return 0;
+    case IORING_OP_READ:
+      return (sqe->offset < 0
+              ? read_fd (fd, sqe->addr, sqe->len, -1)
+              : pread_fd (fd, sqe->addr, sqe->len, sqe->offset));
+    case IORING_OP_WRITE:
+      return (sqe->offset < 0
+              ? write_fd (fd, sqe->addr, sqe->len, -1)
+              : pwrite_fd (fd, sqe->addr, sqe->len, sqe->offset));
+    case IORING_OP_OPEN:
+      return sys_open (sqe->addr);
+    case IORING_OP_CLOSE:
+      return close_fd (sqe->fd);
+    case IORING_OP_FSYNC:
+      /* Writes go straight to the disk, so there is nothing to
+         flush. */
+      return 0;
+    default:
+      return -1;
+    }
+}
+
+/* Io_setup system call.  Registers URING as the process's I/O
+   ring. */
+static int
+sys_io_setup (struct io_ring *uring)
+{
+  struct io_ring ring;
+
+  copy_in (&ring, uring, sizeof ring);
+  if (!io_ring_valid (&ring))
+    return -1;
+  process_current ()->io_ring = uring;
+  return 0;
+}
+
+/* Io_enter system call.  Performs up to TO_SUBMIT operations
+   from the process's I/O ring's submission queue, stopping early
+   if the submission queue runs empty or the completion queue
+   fills up, and returns the number performed. */
+static int
+sys_io_enter (unsigned to_submit)
+{
+  struct io_ring *uring = process_current ()->io_ring;
+  struct io_ring ring;
+  unsigned mask;
+  unsigned done;
+
+  if (uring == NULL)
+    return -1;
+  copy_in (&ring, uring, sizeof ring);
+  if (!io_ring_valid (&ring))
+    return -1;
+  mask = ring.entries - 1;
+
+  for (done = 0; done < to_submit; done++)
+    {
+      struct io_sqe sqe;
+      struct io_cqe cqe;
+
+      if (ring.sq_head == ring.sq_tail
+          || ring.cq_tail - ring.cq_head == ring.entries)
+        break;
+      copy_in (&sqe, &ring.sqes[ring.sq_head++ & mask], sizeof sqe);
+      cqe.user_data = sqe.user_data;
+      cqe.result = io_perform (&sqe);
+      release_held_fds ();
+      copy_out (&ring.cqes[ring.cq_tail++ & mask], &cqe, sizeof cqe);
+    }
+
+  copy_out (&uring->sq_head, &ring.sq_head, sizeof ring.sq_head);
+  copy_out (&uring->cq_tail, &ring.cq_tail, sizeof ring.cq_tail);
+  return done;
+}
+
+#ifdef VM
+/* Binds a mapping id to a region of memory and a file or a
+   shared memory segment, if any.  A process's mappings are
+   protected by its `mappings_lock'. */
+struct mapping
+  {
+    struct list_elem elem;      /* List element. */
+    int handle;                 /* Mapping id. */
+    struct file *file;          /* File. */
+    struct shm *shm;            /* Shared memory segment. */
+    uint8_t *base;              /* Start of memory mapping. */
+    size_t page_cnt;            /* Number of pages mapped. */
+  };
+
+/* Returns the mapping associated with the given handle, or a
+   null pointer if HANDLE is not associated with a memory
+   mapping.  The caller must hold the process's mappings_lock. */
+static struct mapping *
+lookup_mapping (int handle)
+{
+  struct thread *cur = process_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&cur->mappings); e != list_end (&cur->mappings);
+       e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->handle == handle)
+        return m;
+    }
+  return NULL;
+}
+
+/* Removes mapping M from the virtual address space, writing
+   back the pages that were modified to the file, and frees it.
+   Pages that were never written stay as they are in the file,
+   so unmapping a large, mostly read mapping costs little.
+   Unmapping the last mapping of a shared memory segment frees
+   the segment.  The caller must hold the process's
+   mappings_lock. */
+static void
+unmap (struct mapping *m)
+{
+  list_remove (&m->elem);
+  while (m->page_cnt-- > 0)
+    page_deallocate (m->base + m->page_cnt * PGSIZE);
+
+  lock_acquire (&filesys_lock);
+  file_close (m->file);
+  lock_release (&filesys_lock);
+  if (m->shm != NULL)
+    shm_close (m->shm);
+  free (m);
+}
+
+/* Mmap system call.  Maps the file open as HANDLE into
+   consecutive pages starting at ADDR.  The pages are read from
+   the file only as they are accessed. */
+static int
+sys_mmap (int handle, void *addr)
+{
+  struct thread *proc = process_current ();
+  struct file_descriptor *fd = lookup_fd (handle);
+  struct mapping *m;
+  off_t length;
+  off_t offset;
+  int mapid;
+
+  if (addr == NULL || pg_ofs (addr) != 0 || fd->file == NULL)
+    return -1;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return -1;
+
+  m->shm = NULL;
+  lock_acquire (&filesys_lock);
+  m->file = file_reopen (fd->file);
+  length = m->file != NULL ? file_length (m->file) : 0;
+  lock_release (&filesys_lock);
+  if (m->file == NULL || length == 0)
+    {
+      lock_acquire (&filesys_lock);
+      file_close (m->file);
+      lock_release (&filesys_lock);
+      free (m);
+      return -1;
+    }
+  m->base = addr;
+  m->page_cnt = 0;
+
+  lock_acquire (&proc->mappings_lock);
+  mapid = m->handle = proc->next_mapid++;
+  list_push_front (&proc->mappings, &m->elem);
+  for (offset = 0; offset < length; offset += PGSIZE)
+    {
+      uint8_t *upage = m->base + offset;
+      off_t bytes = length - offset >= PGSIZE ? PGSIZE : length - offset;
+      struct page *p;
+
+      p = (is_user_vaddr (upage)
+           ? page_allocate_mapped (upage, m->file, offset, bytes)
+           : NULL);
+      if (p == NULL)
+        {
+          unmap (m);
+          mapid = -1;
+          break;
+        }
+      m->page_cnt++;
+    }
+  lock_release (&proc->mappings_lock);
+
+  return mapid;
+}
+
+/* Munmap system call. */
+static int
+sys_munmap (int mapping)
+{
+  struct thread *proc = process_current ();
+  struct mapping *m;
+
+  lock_acquire (&proc->mappings_lock);
+  m = lookup_mapping (mapping);
+  if (m != NULL)
+    unmap (m);
+  lock_release (&proc->mappings_lock);
+
+  if (m == NULL)
+    thread_exit ();
+  return 0;
+}
+
+/* Madvise system call. */
+static int
+sys_madvise (void *addr, unsigned length, int advice)
+{
+  return page_advise (addr, length, advice) ? 0 : -1;
+}
+
+/* Sbrk system call.  Moves the end of the heap INCREMENT bytes
+   up or down and returns its old address.  Pages added to the
+   heap are zeroed on first access; pages removed from it are
+   freed.  The heap may not grow into the region reserved for
+   the stacks of the process's threads, or shrink below its
+   start. */
+static int
+sys_sbrk (int increment)
+{
+  struct thread *t = process_current ();
+  uintptr_t limit = ((uintptr_t) PHYS_BASE
+                     - (stack_page_limit
+                        + THREAD_STACK_CNT * THREAD_STACK_PAGES) * PGSIZE);
+  uintptr_t old_brk, new_brk;
+  uint8_t *old_top, *new_top;
+  uint8_t *upage;
+  int retval = -1;
+
+  lock_acquire (&t->mappings_lock);
+  old_brk = (uintptr_t) t->heap_brk;
+  new_brk = old_brk + increment;
+  old_top = pg_round_up (t->heap_brk);
+  if (increment > 0
+      ? new_brk < old_brk || new_brk > limit
+      : new_brk > old_brk || new_brk < (uintptr_t) t->heap_start)
+    goto done;
+  new_top = pg_round_up ((void *) new_brk);
+
+  for (upage = old_top; upage < new_top; upage += PGSIZE)
+    if (page_allocate (upage, true) == NULL)
+      {
+        while (upage > old_top)
+          page_deallocate (upage -= PGSIZE);
+        goto done;
+      }
+  for (upage = new_top; upage < old_top; upage += PGSIZE)
+    page_deallocate (upage);
+
+  t->heap_brk = (uint8_t *) new_brk;
+  retval = old_brk;
+
+ done:
+  lock_release (&t->mappings_lock);
+  return retval;
+}
+
+/* Anonymous mmap system call.  Maps LENGTH bytes of zeroed
+   memory, rounded up to whole pages, starting at ADDR.  The
+   pages are zeroed only as they are accessed.  Unmapping them
+   with munmap() discards them. */
+static int
+sys_mmap_anon (void *addr, unsigned length)
+{
+  struct thread *proc = process_current ();
+  struct mapping *m;
+  size_t offset;
+  int mapid;
+
+  if (addr == NULL || pg_ofs (addr) != 0 || length == 0)
+    return -1;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return -1;
+
+  m->file = NULL;
+  m->shm = NULL;
+  m->base = addr;
+  m->page_cnt = 0;
+
+  lock_acquire (&proc->mappings_lock);
+  mapid = m->handle = proc->next_mapid++;
+  list_push_front (&proc->mappings, &m->elem);
+  for (offset = 0; offset < length; offset += PGSIZE)
+    {
+      uint8_t *upage = m->base + offset;
+
+      if (!is_user_vaddr (upage) || page_allocate (upage, true) == NULL)
+        {
+          unmap (m);
+          mapid = -1;
+          break;
+        }
+      m->page_cnt++;
+    }
+  lock_release (&proc->mappings_lock);
+
+  return mapid;
+}
+
+/* Shm_map system call.  Maps the shared memory segment named
+   UNAME, SIZE bytes long rounded up to whole pages, starting at
+   ADDR, creating the segment if it does not exist.  An existing
+   segment must be at least that long.  A new segment's pages are
+   zeroed only as they are accessed, and every process that maps
+   the segment sees the others' writes to it.  The segment exists
+   as long as it is mapped: munmap() or shm_unmap() of its last
+   mapping frees it. */
+static int
+sys_shm_map (const char *uname, unsigned size, void *addr)
+{
+  struct thread *proc = process_current ();
+  char *kname = copy_in_string (uname);
+  struct mapping *m;
+  struct shm *shm;
+  size_t page_cnt;
+  int mapid;
+
+  if (addr == NULL || pg_ofs (addr) != 0 || size == 0)
+    {
+      palloc_free_page (kname);
+      return -1;
+    }
+  page_cnt = DIV_ROUND_UP (size, PGSIZE);
+  shm = shm_open (kname, page_cnt);
+  palloc_free_page (kname);
+  if (shm == NULL)
+    return -1;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    {
+      shm_close (shm);
+      return -1;
+    }
+
+  m->file = NULL;
+  m->shm = shm;
+  m->base = addr;
+  m->page_cnt = 0;
+
+  lock_acquire (&proc->mappings_lock);
+  mapid = m->handle = proc->next_mapid++;
+  list_push_front (&proc->mappings, &m->elem);
+  while (m->page_cnt < page_cnt)
+    {
+      uint8_t *upage = m->base + m->page_cnt * PGSIZE;
+      struct page *p;
+
+      p = (is_user_vaddr (upage)
+           ? page_allocate_shared (upage, shm_page (shm, m->page_cnt))
+           : NULL);
+      if (p == NULL)
+        {
+          unmap (m);
+          mapid = -1;
+          break;
+        }
+      m->page_cnt++;
+    }
+  lock_release (&proc->mappings_lock);
+
+  return mapid;
+}
+
+/* Shm_unmap system call.  Removes the shared memory mapping that
+   starts at ADDR, if there is one. */
+static int
+sys_shm_unmap (void *addr)
+{
+  struct thread *cur = process_current ();
+  struct list_elem *e;
+  int retval = -1;
+
+  lock_acquire (&cur->mappings_lock);
+  for (e = list_begin (&cur->mappings); e != list_end (&cur->mappings);
+       e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->shm != NULL && m->base == addr)
+        {
+          unmap (m);
+          retval = 0;
+          break;
+        }
+    }
+  lock_release (&cur->mappings_lock);
+  return retval;
+}
+#else /* !VM */
+/* Mmap system call.  Memory-mapped files require virtual
+   memory, so this always fails. */
+static int
+sys_mmap (int handle UNUSED, void *addr UNUSED)
+{
+  return -1;
+}
+
+/* Munmap system call.  No mapping can exist without virtual
+   memory, so any mapping id is invalid. */
+static int
+sys_munmap (int mapping UNUSED)
+{
+  thread_exit ();
+}
+
+/* Madvise system call.  Without virtual memory, every page is
+   always in memory and cannot be discarded, so this always
+   fails. */
+static int
+sys_madvise (void *addr UNUSED, unsigned length UNUSED, int advice UNUSED)
+{
+  return -1;
+}
+
+/* Sbrk system call.  The heap is made of pages that are brought
+   in on demand, which requires virtual memory, so this always
+   fails. */
+static int
+sys_sbrk (int increment UNUSED)
+{
+  return -1;
+}
+
+/* Anonymous mmap system call.  Like mmap(), this always fails
+   without virtual memory. */
+static int
+sys_mmap_anon (void *addr UNUSED, unsigned length UNUSED)
+{
+  return -1;
+}
+
+/* Shm_map system call.  Shared memory is made of pages that are
+   brought in on demand, so this always fails without virtual
+   memory. */
+static int
+sys_shm_map (const char *uname UNUSED, unsigned size UNUSED,
+             void *addr UNUSED)
+{
+  return -1;
+}
+
+/* Shm_unmap system call.  No shared memory can be mapped without
+   virtual memory. */
+static int
+sys_shm_unmap (void *addr UNUSED)
+{
+  return -1;
+}
+#endif /* !VM */
+
+/* Fork system call.  The process's mappings and heap stay put
+   while the child copies them. */
+static int
+sys_fork (struct intr_frame *f)
+{
+#ifdef VM
+  struct thread *proc = process_current ();
+  tid_t tid;
+
+  lock_acquire (&proc->mappings_lock);
+  tid = process_fork (f);
+  lock_release (&proc->mappings_lock);
+  return tid;
+#else
+  return process_fork (f);
+#endif
+}
+
+/* Thread_create system call.  Starts a new thread in the
+   process, which runs from ENTRY with FUNC and AUX as its
+   arguments.  See process_thread_create(). */
+static int
+sys_thread_create (void (*entry) (void), void *func, void *aux)
+{
+  return process_thread_create (entry, func, aux);
+}
+
+/* Thread_join system call. */
+static int
+sys_thread_join (tid_t tid)
+{
+  return process_thread_join (tid);
+}
+
+/* Thread_exit system call. */
+static int
+sys_thread_exit (int status)
+{
+  process_thread_exit (status);
+}
+
+/* Gives the running thread a table of file descriptors copied
+   from PARENT's, sharing PARENT's file descriptors.  Copies only
+   the handles without the close-on-exec flag, unless ALL is true.
+   If PARENT is a kernel thread, with no table of its own, the
+   running thread gets just the console, as handles 0 and 1.
+   Returns true if successful, false if memory allocation
+   fails. */
+static bool
+copy_fds (struct thread *parent, bool all)
+{
+  struct thread *cur = thread_current ();
+  size_t i;
+
+  lock_acquire (&filesys_lock);
+  if (!grow_fds (cur, parent->fd_cnt > 0 ? parent->fd_cnt : FD_TABLE_MIN))
+    {
+      lock_release (&filesys_lock);
+      return false;
+    }
+  if (parent->fds == NULL)
+    {
+      bind_handle (cur, STDIN_FILENO, &console_in, false);
+      bind_handle (cur, STDOUT_FILENO, &console_out, false);
+    }
+  else
+    for (i = 0; i < parent->fd_cnt; i++)
+      if (parent->fds[i] != NULL)
+        {
+          bool cloexec = bitmap_test (parent->fd_cloexec, i);
+          if (all || !cloexec)
+            bind_handle (cur, i, parent->fds[i], cloexec);
+        }
+  lock_release (&filesys_lock);
+
+  return true;
+}
+
+/* Gives the running thread, a new process being started by
+   PARENT with exec(), the file descriptors of PARENT that are
+   not marked close-on-exec.  Returns true if successful, false
+   if memory allocation fails. */
+bool
+syscall_exec (struct thread *parent)
+{
+  return copy_fds (parent, false);
+}
+
+/* Gives the running thread, a child being forked from PARENT,
+   all of PARENT's file descriptors, with the same handles, its
+   I/O ring, and copies of its anonymous and shared memory
+   mappings, whose pages page_table_copy() has already copied.
+   The forking thread holds PARENT's mappings_lock.  Returns true
+   if successful, false if memory allocation fails. */
+bool
+syscall_fork (struct thread *parent)
+{
+  struct thread *cur = thread_current ();
+  bool success = copy_fds (parent, true);
+#ifdef VM
+  struct list_elem *e;
+#endif
+
+  cur->io_ring = parent->io_ring;
+
+#ifdef VM
+  cur->next_mapid = parent->next_mapid;
+  for (e = list_begin (&parent->mappings); e != list_end (&parent->mappings);
+       e = list_next (e))
+    {
+      struct mapping *pm = list_entry (e, struct mapping, elem);
+      struct mapping *m;
+
+      if (pm->file != NULL)
+        continue;
+      m = malloc (sizeof *m);
+      if (m == NULL)
+        {
+          success = false;
+          break;
+        }
+      *m = *pm;
+      if (m->shm != NULL)
+        shm_reopen (m->shm);
+      list_push_back (&cur->mappings, &m->elem);
+    }
+#endif
+
+  return success;
+}
+
+/* Closes every handle of the running process, keeping the
+   handle table itself.  A file descriptor that another thread's
+   system call is using stays open until that call returns, but
+   each pipe end that only the table held is closed now, waking
+   any thread blocked on its other end. */
+void
+syscall_close_handles (void)
+{
+  struct thread *proc = process_current ();
+  int handle;
+
+  lock_acquire (&filesys_lock);
+  for (handle = 0; (size_t) handle < proc->fd_cnt; handle++)
+    if (proc->fds[handle] != NULL)
+      close_handle (proc, handle);
+  lock_release (&filesys_lock);
+}
+
+/* On thread exit, let go of the file descriptors that the
+   thread's system call was using.  On process exit, also close
+   all open files and unmap all mappings, writing back the pages
+   of each mapping that were modified. */
+void
+syscall_exit (void)
+{
+  struct thread *cur = thread_current ();
+
+  release_held_fds ();
+  if (cur->process != cur)
+    return;
+
+#ifdef VM
+  while (!list_empty (&cur->mappings))
+    unmap (list_entry (list_front (&cur->mappings), struct mapping, elem));
+#endif
+
+  if (cur->fds != NULL)
+    {
+      syscall_close_handles ();
+      free (cur->fds);
+      bitmap_destroy (cur->fd_map);
+      bitmap_destroy (cur->fd_cloexec);
+      cur->fds = NULL;
+      cur->fd_cnt = 0;
+    }
 }
@@ -1,6 +1,16 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+#include <stdbool.h>
+#include "threads/thread.h"
+
 void syscall_init (void);
+bool syscall_exec (struct thread *parent);
+bool syscall_fork (struct thread *parent);
+void syscall_close_handles (void);
+void syscall_exit (void);
+
+/* Entry point for SYSENTER, in userprog/sysenter.S. */
+void sysenter_entry (void);
 
 #endif /* userprog/syscall.h */
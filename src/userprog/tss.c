@@ -81,7 +81,8 @@ tss_init (void)
 {
   /* Our TSS is never used in a call gate or task gate, so only a
      few fields of it are ever referenced, and those are the only
-     ones we initialize. */
+     ones we initialize.  The rest of the page is the stack that
+     SYSENTER starts out on; see userprog/sysenter.S. */
   tss = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   tss->ss0 = SEL_KDSEG;
   tss->bitmap = 0xdfff;
@@ -0,0 +1,88 @@
+#include "userprog/usercopy.h"
+#include <stdint.h>
+#include "threads/interrupt.h"
+#include "threads/vaddr.h"
+
+/* Copying to and from user memory.
+
+   The kernel does not check a user buffer page by page before
+   using it.  It checks only that the buffer lies below
+   PHYS_BASE, and then copies it with a plain string move.  If
+   part of the buffer is not in memory, the page fault handler
+   brings it in, as for the process itself.  If part of it is
+   not mapped at all, the handler calls usercopy_fixup(), which
+   makes the copy fail instead.
+
+   With VM, a fault may need to read the page from a file or
+   swap, so these functions must not be called with the file
+   system lock held. */
+
+/* Primitives in usercopy-asm.S. */
+int usercopy (void *dst, const void *src, size_t size);
+int usercopy_string (char *dst, const char *src, size_t size);
+extern const char usercopy_begin[], usercopy_end[], usercopy_fault[];
+
+/* Returns true if the SIZE bytes at UADDR are all in user
+   virtual memory. */
+static bool
+is_user_range (const void *uaddr, size_t size)
+{
+  return (is_user_vaddr (uaddr)
+          && size <= (size_t) ((uint8_t *) PHYS_BASE - (uint8_t *) uaddr));
+}
+
+/* Copies SIZE bytes from user address USRC to kernel address
+   DST.  Returns true if successful, false if any of the user
+   bytes are not accessible. */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size)
+{
+  return is_user_range (usrc, size) && usercopy (dst, usrc, size) == 0;
+}
+
+/* Copies SIZE bytes from kernel address SRC to user address
+   UDST.  Returns true if successful, false if any of the user
+   bytes are not accessible.  Some bytes may have been copied
+   even on failure. */
+bool
+copy_to_user (void *udst, const void *src, size_t size)
+{
+  return is_user_range (udst, size) && usercopy (udst, src, size) == 0;
+}
+
+/* Copies the null-terminated string at user address USRC into
+   the SIZE bytes at kernel address DST.  Returns the length of
+   the string, not counting the null terminator, which is SIZE if
+   the string did not fit, in which case DST is not
+   null-terminated.  Returns -1 if the string is not accessible,
+   including if it runs past the end of user memory. */
+int
+strncpy_from_user (char *dst, const char *usrc, size_t size)
+{
+  size_t limit;
+  int length;
+
+  if (!is_user_vaddr (usrc))
+    return -1;
+  limit = (uint8_t *) PHYS_BASE - (uint8_t *) usrc;
+  if (size <= limit)
+    return usercopy_string (dst, usrc, size);
+
+  length = usercopy_string (dst, usrc, limit);
+  return length == (int) limit ? -1 : length;
+}
+
+/* Called by the page fault handler for a fault in F that it
+   could not resolve, taken by the kernel.  If the fault is in
+   one of the copying primitives, arranges for it to fail, and
+   returns true.  Otherwise, returns false. */
+bool
+usercopy_fixup (struct intr_frame *f)
+{
+  const char *eip = (const char *) f->eip;
+
+  if (eip < usercopy_begin || eip >= usercopy_end)
+    return false;
+  f->eip = (void (*) (void)) usercopy_fault;
+  return true;
+}
@@ -0,0 +1,606 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include "vm/page.h"
+#include "vm/swap.h"
+#include "devices/timer.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+
+/* All frames in use, in the order the clock hand visits them. */
+static struct list frame_list;
+
+/* Frames not in use.  The frame table takes the whole user pool
+   at startup and frames are never freed, only moved between the
+   two lists, because a thread in frame_lock() may still be about
+   to acquire the lock of a frame just evicted from under it. */
+static struct list free_list;
+static size_t free_cnt;         /* Number of frames in FREE_LIST. */
+
+/* Next frame for the clock hand to examine, or the list's end
+   to start over at its beginning. */
+static struct list_elem *hand;
+
+/* Protects FRAME_LIST, FREE_LIST, FREE_CNT, HAND, and
+   PAGEOUT_AWAKE. */
+static struct lock scan_lock;
+
+/* Free frame watermarks.  When fewer than LOW_WATER frames are
+   free, the pageout thread wakes up and evicts pages until
+   HIGH_WATER frames are free, so that page faults normally find
+   a free frame without evicting anything themselves. */
+static size_t low_water;
+static size_t high_water;
+
+/* The zero frame. */
+static struct frame zero_frame;
+
+/* Wakes up the pageout thread. */
+static struct semaphore pageout_sema;
+static bool pageout_awake;      /* Is the pageout thread busy? */
+
+/* Frames holding read-only file data, keyed on the data, so that
+   processes running the same executable share its text.  A
+   thread that holds SHARE_LOCK may only try to acquire a frame's
+   lock, never wait for it, because unshare() acquires
+   SHARE_LOCK with a frame's lock held. */
+static struct hash share_table;
+static struct lock share_lock;
+
+static hash_hash_func share_hash;
+static hash_less_func share_less;
+static thread_func pageout NO_RETURN;
+
+/* Initializes the frame table, taking every page in the user
+   pool, and starts the pageout thread. */
+void
+frame_init (void) 
+{
+  void *base;
+
+  list_init (&frame_list);
+  list_init (&free_list);
+  free_cnt = 0;
+  hand = list_end (&frame_list);
+  lock_init (&scan_lock);
+  hash_init (&share_table, share_hash, share_less, NULL);
+  lock_init (&share_lock);
+
+  lock_init (&zero_frame.lock);
+  zero_frame.base = palloc_get_page (PAL_USER | PAL_ZERO | PAL_ASSERT);
+  list_init (&zero_frame.pages);
+  zero_frame.ref_cnt = 1;
+  zero_frame.inode = NULL;
+
+  while ((base = palloc_get_page (PAL_USER)) != NULL) 
+    {
+      struct frame *f = malloc (sizeof *f);
+      if (f == NULL) 
+        {
+          palloc_free_page (base);
+          break;
+        } 
+      lock_init (&f->lock);
+      f->base = base;
+      list_init (&f->pages);
+      f->ref_cnt = 0;
+      f->inode = NULL;
+      list_push_back (&free_list, &f->elem);
+      free_cnt++;
+    }
+
+  /* Keep a reserve of about 1/64 of memory, but at least enough
+     for a full swap cluster. */
+  low_water = free_cnt / 64;
+  if (low_water < SWAP_CLUSTER)
+    low_water = SWAP_CLUSTER;
+  high_water = low_water * 2;
+  if (high_water > free_cnt / 2)
+    high_water = low_water = 0;
+
+  sema_init (&pageout_sema, 0);
+  pageout_awake = false;
+  thread_create ("pageout", PRI_DEFAULT, pageout, NULL);
+}
+
+/* Returns the frame under the clock hand and advances the hand,
+   wrapping around at the end of the list.
+   The frame list must not be empty. */
+static struct frame *
+clock_next (void) 
+{
+  struct frame *f;
+
+  ASSERT (lock_held_by_current_thread (&scan_lock));
+  ASSERT (!list_empty (&frame_list));
+
+  if (hand == list_end (&frame_list))
+    hand = list_begin (&frame_list);
+  f = list_entry (hand, struct frame, elem);
+  hand = list_next (hand);
+  return f;
+}
+
+/* Removes frame F, which must be locked, from the share table,
+   if it is there. */
+static void
+unshare (struct frame *f) 
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  if (f->inode != NULL) 
+    {
+      lock_acquire (&share_lock);
+      hash_delete (&share_table, &f->share_elem);
+      f->inode = NULL;
+      lock_release (&share_lock);
+    }
+}
+
+/* Moves frame F, which must be locked and have no pages, from
+   the frame list to the free list, keeping the clock hand
+   valid. */
+static void
+put_free_frame (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&scan_lock));
+  ASSERT (f->ref_cnt == 0);
+
+  unshare (f);
+  if (hand == &f->elem)
+    hand = list_next (hand);
+  list_remove (&f->elem);
+  list_push_back (&free_list, &f->elem);
+  free_cnt++;
+}
+
+/* Takes a frame from the free list, records it in the frame
+   table, and returns it locked, without any pages.  Returns a
+   null pointer if the free list is empty.  Wakes the pageout
+   thread if the free list runs low. */
+static struct frame *
+get_free_frame (void)
+{
+  struct frame *f = NULL;
+
+  ASSERT (lock_held_by_current_thread (&scan_lock));
+
+  if (!list_empty (&free_list))
+    {
+      f = list_entry (list_pop_front (&free_list), struct frame, elem);
+      free_cnt--;
+      lock_acquire (&f->lock);
+
+      /* Insert just behind the hand, so that the new frame is
+         the last one the clock comes around to. */
+      list_insert (hand, &f->elem);
+    }
+
+  if (free_cnt < low_water && !pageout_awake) 
+    {
+      pageout_awake = true;
+      sema_up (&pageout_sema);
+    }
+  return f;
+}
+
+/* Returns true if any page in frame F, which must be locked,
+   was accessed since the clock hand last came around, and
+   clears all of their accessed bits. */
+static bool
+frame_accessed_recently (struct frame *f)
+{
+  struct list_elem *e;
+  bool accessed = false;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    if (page_accessed_recently (list_entry (e, struct page, frame_elem)))
+      accessed = true;
+  return accessed;
+}
+
+/* Returns true if any page in frame F, which must be locked,
+   has been modified since it was brought in. */
+static bool
+frame_is_dirty (struct frame *f)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    if (page_is_dirty (list_entry (e, struct page, frame_elem)))
+      return true;
+  return false;
+}
+
+/* Returns true if frame F, which the clock hand has just
+   reached, should be evicted, in which case it is returned
+   locked.  A frame is passed over if it is pinned or one of its
+   pages was accessed since the hand last came around.  If
+   CLEAN_ONLY is true, a frame that is dirty is passed over,
+   too. */
+static bool
+choose_victim (struct frame *f, bool clean_only) 
+{
+  if (!lock_try_acquire (&f->lock))
+    return false;
+
+  if (frame_accessed_recently (f)
+      || (clean_only && frame_is_dirty (f)))
+    {
+      lock_release (&f->lock);
+      return false;
+    }
+  return true;
+}
+
+/* Moves the clock hand onward, looking at up to FRAME_CNT - 1
+   frames, to find up to MAX_CNT more dirty victims to go to
+   swap along with the one just chosen.  (Looking at more frames
+   would bring the hand back around to that one.)  Stores the
+   victims' frames, locked, into VICTIMS[] and returns their
+   number. */
+static size_t
+gather_cluster (struct frame *victims[], size_t max_cnt, size_t frame_cnt) 
+{
+  size_t cnt = 0;
+  size_t i;
+
+  for (i = 0; i + 1 < frame_cnt && cnt < max_cnt; i++) 
+    {
+      struct frame *f = clock_next ();
+      if (!choose_victim (f, false))
+        continue;
+      if (frame_is_dirty (f))
+        victims[cnt++] = f;
+      else
+        lock_release (&f->lock);
+    }
+  return cnt;
+}
+
+/* Evicts the pages in the next frame that the clock hand
+   selects, and returns the frame locked, with no pages, or a null
+   pointer if none could be evicted.  Must be called with the
+   scan lock held, which is released while the victims are
+   written out and held again on return.
+
+   Eviction uses the clock (second chance) algorithm: a frame
+   whose pages' accessed bits are set has the bits cleared and
+   is passed over until the hand comes around again.  The hand
+   thereby samples the accessed bits of every page directory
+   that maps each frame, aging frames that go unused.  On the
+   first revolution, frames that are dirty are passed over too,
+   since evicting a clean frame needs no writeback.
+
+   When the victim is dirty, the hand sweeps on for a few more
+   dirty victims, so that they can be written to swap together
+   as one sequential run.  Those frames then go on the free
+   list, so that the next several allocations need not evict at
+   all.
+
+   A frame that no page maps any longer, kept only for the sake
+   of the share table, has nothing to write out and is taken as
+   soon as the hand reaches it. */
+static struct frame *
+evict (void)
+{
+  struct frame *f;
+  size_t frame_cnt;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&scan_lock));
+
+  frame_cnt = list_size (&frame_list);
+  for (i = 0; i < frame_cnt * 2; i++) 
+    {
+      struct frame *victims[SWAP_CLUSTER];
+      size_t victim_cnt = 1;
+      size_t j;
+
+      f = clock_next ();
+      if (!choose_victim (f, i < frame_cnt))
+        continue;
+
+      if (f->ref_cnt == 0) 
+        {
+          unshare (f);
+          return f;
+        }
+
+      victims[0] = f;
+      if (frame_is_dirty (f))
+        victim_cnt += gather_cluster (victims + 1, SWAP_CLUSTER - 1,
+                                      frame_cnt);
+
+      /* Write out the victims without holding the scan lock, so
+         that other threads can use the frame table meanwhile.
+         The victims stay pinned by their frame locks. */
+      lock_release (&scan_lock);
+      page_out_cluster (victims, victim_cnt);
+
+      lock_acquire (&scan_lock);
+      for (j = 1; j < victim_cnt; j++)
+        {
+          if (victims[j]->ref_cnt == 0)
+            put_free_frame (victims[j]);
+          lock_release (&victims[j]->lock);
+        } 
+
+      if (f->ref_cnt == 0)
+        {
+          unshare (f);
+          return f;
+        }
+      lock_release (&f->lock);
+    }
+  return NULL;
+}
+
+/* Pageout thread.  Sleeps until the free list runs low, then
+   evicts pages until it is back up to the high watermark, doing
+   the scanning and the writing back of dirty pages that page
+   faults would otherwise have to do. */
+static void
+pageout (void *aux UNUSED) 
+{
+  for (;;) 
+    {
+      sema_down (&pageout_sema);
+
+      lock_acquire (&scan_lock);
+      while (free_cnt < high_water) 
+        {
+          struct frame *f = evict ();
+          if (f == NULL)
+            break;
+          put_free_frame (f);
+          lock_release (&f->lock);
+        } 
+      pageout_awake = false;
+      lock_release (&scan_lock);
+    }
+}
+
+/* Tries to find a frame, evicting the pages in another frame if
+   none is free.  Returns the frame locked, or a null pointer if
+   no frame could be freed. */
+static struct frame *
+try_frame_alloc_and_lock (void)
+{
+  struct frame *f;
+
+  lock_acquire (&scan_lock);
+  f = get_free_frame ();
+  if (f == NULL) 
+    f = evict ();
+  lock_release (&scan_lock);
+  return f;
+}
+
+/* Obtains and returns a locked frame with no pages, evicting
+   other pages if necessary.  Returns a null pointer if no frame
+   can be found even after waiting for other threads to release
+   theirs. */
+struct frame *
+frame_alloc_and_lock (void)
+{
+  size_t try;
+
+  for (try = 0; try < 3; try++) 
+    {
+      struct frame *f = try_frame_alloc_and_lock ();
+      if (f != NULL) 
+        {
+          ASSERT (lock_held_by_current_thread (&f->lock));
+          return f; 
+        } 
+      timer_msleep (1000);
+    }
+
+  return NULL;
+}
+
+/* Returns the zero frame, locked.  A page attached to it must
+   not write to it. */
+struct frame *
+frame_lock_zero (void) 
+{
+  lock_acquire (&zero_frame.lock);
+  return &zero_frame;
+}
+
+/* Finds the frame in the share table that holds BYTES bytes of
+   read-only data from OFFSET in INODE, as INODE is now, followed
+   by zeros, and returns it locked, or returns a null pointer if
+   there is none. */
+static struct frame *
+lookup_shared (struct inode *inode, off_t offset, off_t bytes) 
+{
+  struct frame key;
+
+  key.inode = inode;
+  key.generation = inode_generation (inode);
+  key.offset = offset;
+  key.bytes = bytes;
+  for (;;) 
+    {
+      struct hash_elem *e;
+      struct frame *f;
+
+      lock_acquire (&share_lock);
+      e = hash_find (&share_table, &key.share_elem);
+      if (e == NULL) 
+        {
+          lock_release (&share_lock);
+          return NULL;
+        } 
+      f = hash_entry (e, struct frame, share_elem);
+      if (lock_try_acquire (&f->lock)) 
+        {
+          lock_release (&share_lock);
+          return f; 
+        } 
+
+      /* The frame is busy, most likely being read in.  Let its
+         holder finish, then look again, since the frame may
+         have been freed meanwhile. */
+      lock_release (&share_lock);
+      thread_yield ();
+    }
+}
+
+/* Obtains a frame for page P, which holds BYTES bytes of
+   read-only data from OFFSET in INODE followed by zeros, and
+   returns it locked, with P attached.  If another process's
+   page already holds the same data, P shares its frame and
+   *FOUND is set to true.  Otherwise, P gets a new frame, which
+   is entered in the share table, and *FOUND is set to false:
+   the caller must then read the data into it, or free the frame
+   with frame_free() if it cannot.  Returns a null pointer if no
+   frame can be found. */
+struct frame *
+frame_alloc_shared (struct page *p, struct inode *inode, off_t offset,
+                    off_t bytes, bool *found) 
+{
+  struct frame *f;
+
+  f = lookup_shared (inode, offset, bytes);
+  *found = f != NULL;
+  if (f == NULL) 
+    {
+      f = frame_alloc_and_lock ();
+      if (f == NULL)
+        return NULL;
+
+      /* If another thread entered the same data meanwhile, just
+         keep this frame out of the table. */
+      lock_acquire (&share_lock);
+      f->inode = inode;
+      f->generation = inode_generation (inode);
+      f->offset = offset;
+      f->bytes = bytes;
+      if (hash_insert (&share_table, &f->share_elem) != NULL)
+        f->inode = NULL;
+      lock_release (&share_lock);
+    }
+  frame_attach (f, p);
+  return f;
+}
+
+/* Locks P's frame into memory, if it has one.
+   Upon return, p->frame will not change until P is unlocked. */
+void
+frame_lock (struct page *p) 
+{
+  /* A frame can be asynchronously removed, but never inserted. */
+  struct frame *f = p->frame;
+  if (f != NULL) 
+    {
+      lock_acquire (&f->lock);
+      if (f != p->frame)
+        {
+          lock_release (&f->lock);
+          ASSERT (p->frame == NULL); 
+        } 
+    }
+}
+
+/* Adds page P, which must not have a frame, to the pages that
+   map frame F, which must be locked by the current thread. */
+void
+frame_attach (struct frame *f, struct page *p)
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (p->frame == NULL);
+
+  list_push_back (&f->pages, &p->frame_elem);
+  f->ref_cnt++;
+  p->frame = f;
+}
+
+/* Removes page P from the pages that map its frame, which must
+   be locked by the current thread.  The frame stays locked. */
+void
+frame_detach (struct page *p)
+{
+  struct frame *f = p->frame;
+
+  ASSERT (f != NULL);
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  list_remove (&p->frame_elem);
+  f->ref_cnt--;
+  p->frame = NULL;
+}
+
+/* Removes page P from its frame, which must be locked by the
+   current thread, and then frees the frame if P was the last
+   page mapping it or unlocks it otherwise.  A frame in the share
+   table stays there instead of being freed, for the next process
+   to run the same executable, until the clock reclaims it. */
+void
+frame_release (struct page *p)
+{
+  struct frame *f = p->frame;
+
+  frame_detach (p);
+  if (f->ref_cnt == 0 && f->inode == NULL)
+    frame_free (f);
+  else
+    frame_unlock (f);
+}
+
+/* Releases frame F, which must have no pages, for use by
+   another page.  F must be locked for use by the current
+   process.  Any data in F is lost. */
+void
+frame_free (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  lock_acquire (&scan_lock);
+  put_free_frame (f);
+  lock_release (&scan_lock);
+  lock_release (&f->lock);
+}
+
+/* Unlocks frame F, allowing it to be evicted.
+   F must be locked for use by the current process. */
+void
+frame_unlock (struct frame *f) 
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  lock_release (&f->lock);
+}
+
+/* Returns a hash value for the file data that frame F holds. */
+static unsigned
+share_hash (const struct hash_elem *f_, void *aux UNUSED) 
+{
+  const struct frame *f = hash_entry (f_, struct frame, share_elem);
+  return (hash_bytes (&f->inode, sizeof f->inode)
+          ^ hash_bytes (&f->generation, sizeof f->generation)
+          ^ hash_int (f->offset));
+}
+
+/* Returns true if the file data that frame A holds precedes
+   that of frame B. */
+static bool
+share_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED) 
+{
+  const struct frame *a = hash_entry (a_, struct frame, share_elem);
+  const struct frame *b = hash_entry (b_, struct frame, share_elem);
+
+  if (a->inode != b->inode)
+    return a->inode < b->inode;
+  else if (a->generation != b->generation)
+    return a->generation < b->generation;
+  else if (a->offset != b->offset)
+    return a->offset < b->offset;
+  else
+    return a->bytes < b->bytes;
+}
@@ -0,0 +1,73 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include "filesys/off_t.h"
+#include "threads/synch.h"
+
+struct page;
+
+/* A physical frame of user memory.
+
+   Every frame handed out from the user pool is tracked here,
+   along with the pages that map it.  Each page in turn
+   identifies the owning thread and user virtual address.
+   Usually a frame holds a single page, but after fork() a
+   frame is shared copy-on-write by the parent's and the
+   child's pages until one of them writes to it, and a frame
+   that holds read-only data from an executable is shared by
+   every process running it.  REF_CNT counts the pages in PAGES;
+   a frame is normally freed when it drops to zero.
+
+   A frame of executable data is found through the share table,
+   keyed on the file data it holds: INODE, as of GENERATION, and
+   OFFSET and BYTES.  It stays in the table after its last page
+   goes away, with a REF_CNT of 0, so that running the program
+   again finds its text still in memory.  The clock reclaims such
+   a frame the first time it comes around to it.
+
+   The zero frame, which is always zero, is mapped by zero-filled
+   pages that have not been written.  It is not in the frame list,
+   so it is never evicted, and it holds a reference to itself, so
+   that it always counts as shared and is never freed.
+
+   A frame is pinned while its lock is held: the clock will not
+   select it for eviction, and its page stays where it is.  The
+   lock is held while a frame's page is being read in or written
+   out, and by the kernel while it accesses the page on a user
+   process's behalf. */
+struct frame 
+  {
+    struct lock lock;           /* Pins the frame. */
+    void *base;                 /* Kernel virtual base address. */
+    struct list pages;          /* Pages mapping the frame. */
+    int ref_cnt;                /* Number of pages in PAGES. */
+
+    /* Shared read-only file data, protected by the share table's
+       lock as well as LOCK. */
+    struct inode *inode;        /* Inode, or null if not in table. */
+    unsigned long long generation; /* INODE's generation. */
+    off_t offset;               /* Offset of data in INODE. */
+    off_t bytes;                /* Bytes of data, rest zeroed. */
+    struct hash_elem share_elem; /* Element in share table. */
+    struct list_elem elem;      /* Element in the frame list. */
+  };
+
+void frame_init (void);
+
+struct frame *frame_alloc_and_lock (void);
+struct frame *frame_lock_zero (void);
+struct frame *frame_alloc_shared (struct page *, struct inode *,
+                                  off_t offset, off_t bytes, bool *found);
+void frame_lock (struct page *);
+
+void frame_attach (struct frame *, struct page *);
+void frame_detach (struct page *);
+void frame_release (struct page *);
+
+void frame_free (struct frame *);
+void frame_unlock (struct frame *);
+
+#endif /* vm/frame.h */
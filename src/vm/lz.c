@@ -0,0 +1,198 @@
+#include "vm/lz.h"
+#include <debug.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Each sequence in a block starts with a token byte.  Its upper
+   4 bits give the number of literal bytes that follow the token,
+   its lower 4 bits the length of the back-reference that follows
+   the literals, less MIN_MATCH.  A field of 15 is extended by
+   bytes that follow, each added in, until one less than 255.  A
+   back-reference is a 16-bit little-endian offset, back from the
+   current position, followed by any extension of its length.
+   The last sequence has only literals. */
+#define MIN_MATCH 4
+#define RUN_MASK 15
+
+/* Matches are found through a hash table of the positions of
+   previous 4-byte strings.  It is too big for a kernel stack, so
+   it is static, which makes lz_compress() non-reentrant. */
+#define HASH_BITS 10
+static uint16_t hash_table[1 << HASH_BITS];
+
+/* Returns the 4 bytes at P as a 32-bit integer. */
+static inline uint32_t
+read32 (const uint8_t *p)
+{
+  uint32_t x;
+  memcpy (&x, p, sizeof x);
+  return x;
+}
+
+/* Returns the hash table index for the 4 bytes at P. */
+static inline unsigned
+hash4 (const uint8_t *p)
+{
+  return (read32 (p) * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/* Writes length LEN, less the RUN_MASK already stored in a
+   token, as extension bytes at *OP, advancing *OP.  Returns false
+   if that would pass END. */
+static bool
+put_length (uint8_t **op, const uint8_t *end, size_t len)
+{
+  for (len -= RUN_MASK; ; len -= 255)
+    {
+      if (*op >= end)
+        return false;
+      *(*op)++ = len < 255 ? len : 255;
+      if (len < 255)
+        return true;
+    }
+}
+
+/* Writes a sequence to *OP, advancing *OP: the LIT_LEN literal
+   bytes at LIT followed, if MATCH_LEN is nonzero, by a
+   back-reference OFFSET bytes back of MATCH_LEN bytes.  Returns
+   false if that would pass END. */
+static bool
+put_sequence (uint8_t **op, const uint8_t *end, const uint8_t *lit,
+              size_t lit_len, size_t offset, size_t match_len)
+{
+  size_t ml = match_len > 0 ? match_len - MIN_MATCH : 0;
+  uint8_t *token;
+
+  if (*op >= end)
+    return false;
+  token = (*op)++;
+  *token = ((lit_len < RUN_MASK ? lit_len : RUN_MASK) << 4
+            | (ml < RUN_MASK ? ml : RUN_MASK));
+  if (lit_len >= RUN_MASK && !put_length (op, end, lit_len))
+    return false;
+
+  if ((size_t) (end - *op) < lit_len)
+    return false;
+  memcpy (*op, lit, lit_len);
+  *op += lit_len;
+
+  if (match_len > 0)
+    {
+      if (end - *op < 2)
+        return false;
+      *(*op)++ = offset & 0xff;
+      *(*op)++ = offset >> 8;
+      if (ml >= RUN_MASK && !put_length (op, end, ml))
+        return false;
+    }
+  return true;
+}
+
+/* Compresses the SRC_SIZE bytes at SRC, which must be less than
+   64 kB, into the DST_SIZE bytes at DST.  Returns the size of
+   the compressed data, or 0 if it does not fit in DST_SIZE
+   bytes, in which case the data is better left uncompressed. */
+size_t
+lz_compress (const void *src_, size_t src_size, void *dst_, size_t dst_size)
+{
+  const uint8_t *src = src_;
+  uint8_t *op = dst_;
+  const uint8_t *end = op + dst_size;
+  size_t anchor = 0;
+  size_t i = 0;
+
+  ASSERT (src_size < 65536);
+
+  /* Positions are stored plus one, so that 0 means none. */
+  memset (hash_table, 0, sizeof hash_table);
+  while (i + MIN_MATCH <= src_size)
+    {
+      unsigned h = hash4 (src + i);
+      size_t cand = hash_table[h];
+      size_t len;
+
+      hash_table[h] = i + 1;
+      if (cand == 0 || read32 (src + cand - 1) != read32 (src + i))
+        {
+          i++;
+          continue;
+        }
+      cand--;
+
+      for (len = MIN_MATCH; i + len < src_size; len++)
+        if (src[cand + len] != src[i + len])
+          break;
+      if (!put_sequence (&op, end, src + anchor, i - anchor, i - cand, len))
+        return 0;
+      i += len;
+      anchor = i;
+    }
+
+  if (!put_sequence (&op, end, src + anchor, src_size - anchor, 0, 0))
+    return 0;
+  return op - (uint8_t *) dst_;
+}
+
+/* Reads a length extension from *IP, advancing *IP, and adds it
+   to *LEN.  Returns false if the extension passes END. */
+static bool
+get_length (const uint8_t **ip, const uint8_t *end, size_t *len)
+{
+  uint8_t b;
+
+  do
+    {
+      if (*ip >= end)
+        return false;
+      b = *(*ip)++;
+      *len += b;
+    }
+  while (b == 255);
+  return true;
+}
+
+/* Decompresses the SRC_SIZE bytes of compressed data at SRC,
+   which must decompress to exactly DST_SIZE bytes, into DST.
+   Returns true if successful, false if the data is corrupt. */
+bool
+lz_decompress (const void *src_, size_t src_size, void *dst_, size_t dst_size)
+{
+  const uint8_t *ip = src_;
+  const uint8_t *ip_end = ip + src_size;
+  uint8_t *dst = dst_;
+  size_t op = 0;
+
+  while (ip < ip_end)
+    {
+      uint8_t token = *ip++;
+      size_t lit_len = token >> 4;
+      size_t match_len = token & RUN_MASK;
+      size_t offset;
+
+      /* Literals. */
+      if (lit_len == RUN_MASK && !get_length (&ip, ip_end, &lit_len))
+        return false;
+      if ((size_t) (ip_end - ip) < lit_len || dst_size - op < lit_len)
+        return false;
+      memcpy (dst + op, ip, lit_len);
+      ip += lit_len;
+      op += lit_len;
+      if (ip == ip_end)
+        break;
+
+      /* Back-reference, which may overlap the bytes it produces,
+         so it is copied a byte at a time. */
+      if (ip_end - ip < 2)
+        return false;
+      offset = ip[0] | (ip[1] << 8);
+      ip += 2;
+      if (match_len == RUN_MASK && !get_length (&ip, ip_end, &match_len))
+        return false;
+      match_len += MIN_MATCH;
+      if (offset == 0 || offset > op || dst_size - op < match_len)
+        return false;
+      for (; match_len > 0; match_len--, op++)
+        dst[op] = dst[op - offset];
+    }
+  return op == dst_size;
+}
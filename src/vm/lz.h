@@ -0,0 +1,18 @@
+#ifndef VM_LZ_H
+#define VM_LZ_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* LZ77-family compression of small blocks, such as pages.
+
+   The format is the one LZ4 uses for a block: a sequence of
+   literal runs, each followed by a back-reference into the data
+   already decompressed, with the last run followed by none. */
+
+size_t lz_compress (const void *src, size_t src_size,
+                    void *dst, size_t dst_size);
+bool lz_decompress (const void *src, size_t src_size,
+                    void *dst, size_t dst_size);
+
+#endif /* vm/lz.h */
@@ -0,0 +1,1044 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <round.h>
+#include <string.h>
+#include <syscall-nr.h>
+#include "vm/frame.h"
+#include "vm/swap.h"
+#include "filesys/file.h"
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+
+/* Maximum size of a user stack, in pages. */
+size_t stack_page_limit = STACK_PAGES_DEFAULT;
+
+/* Maximum number of file-backed pages brought in by a fault. */
+size_t fault_around_limit = FAULT_AROUND_DEFAULT;
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static bool map_page (struct page *);
+
+/* Serializes bringing in the pages of shared memory segments, so
+   that no two processes bring in the same one at once. */
+static struct lock shared_lock;
+
+/* Initializes the supplemental page table module. */
+void
+page_init (void) 
+{
+  lock_init (&shared_lock);
+}
+
+/* Creates an empty supplemental page table for the running
+   thread.  Returns true if successful, false if memory
+   allocation fails. */
+bool
+page_table_create (void) 
+{
+  struct thread *t = thread_current ();
+
+  ASSERT (t->pages == NULL);
+  t->pages = malloc (sizeof *t->pages);
+  if (t->pages == NULL)
+    return false;
+  if (!hash_init (t->pages, page_hash, page_less, NULL)) 
+    {
+      free (t->pages);
+      t->pages = NULL;
+      return false;
+    }
+  return true;
+}
+
+/* Makes the running thread's supplemental page table, which
+   must be empty, a copy of PARENT's, for fork().  Each page in
+   memory shares PARENT's frame, and each page in swap shares
+   PARENT's slot, so that copying the address space costs little
+   more than copying its page table.  Both sides' mappings of a
+   shared frame are read-only, so that the first write to one
+   gives the writer its own copy.
+
+   Memory-mapped files are not inherited, but anonymous mappings
+   are, as the private memory they are, and shared memory
+   mappings are, as shared memory: the child's pages map the same
+   segment pages as PARENT's.  The running thread's
+   executable must be open as its `bin_file'.  PARENT's threads
+   keep running, but cannot change its pages until this function
+   returns.  Returns true if successful, false if memory
+   allocation fails. */
+bool
+page_table_copy (struct thread *parent) 
+{
+  struct thread *t = thread_current ();
+  struct hash_iterator i;
+  bool success = false;
+
+  lock_acquire (&parent->pages_lock);
+  hash_first (&i, parent->pages);
+  while (hash_next (&i)) 
+    {
+      struct page *pp = hash_entry (hash_cur (&i), struct page, hash_elem);
+      struct page *p;
+
+      if (!pp->private)
+        continue;
+
+      p = page_allocate (pp->addr, pp->writable);
+      if (p == NULL)
+        goto done;
+      ASSERT (pp->file == NULL || pp->file == parent->bin_file);
+      p->file = pp->file != NULL ? t->bin_file : NULL;
+      p->file_offset = pp->file_offset;
+      p->file_bytes = pp->file_bytes;
+      p->shared = pp->shared;
+      if (p->shared != NULL)
+        continue;
+
+      frame_lock (pp);
+      if (pp->frame != NULL) 
+        {
+          struct frame *f = pp->frame;
+          uint32_t *ppd = parent->pagedir;
+
+          frame_attach (f, p);
+          if (pp->writable)
+            pagedir_set_writable (ppd, pp->addr, false);
+          if (!map_page (p)) 
+            {
+              frame_detach (p);
+              frame_unlock (f);
+              goto done;
+            }
+          pagedir_set_dirty (t->pagedir, p->addr,
+                             pagedir_is_dirty (ppd, pp->addr));
+          frame_unlock (f);
+        }
+      else if (pp->swap_slot != SWAP_SLOT_NONE)
+        swap_share (p, pp->swap_slot);
+    }
+  success = true;
+
+ done:
+  lock_release (&parent->pages_lock);
+  return success;
+}
+
+/* Frees page P and the frame or swap slot that holds it, if
+   any.  Used as a hash action function. */
+static void
+destroy_page (struct hash_elem *p_, void *aux UNUSED) 
+{
+  struct page *p = hash_entry (p_, struct page, hash_elem);
+
+  frame_lock (p);
+  if (p->frame != NULL)
+    frame_release (p);
+  swap_discard (p);
+  free (p);
+}
+
+/* Destroys the running thread's supplemental page table,
+   freeing the frames that its pages occupy.  Must be called
+   before the thread's page directory is destroyed, because the
+   clock may be examining the page directory until the frames
+   are freed. */
+void
+page_exit (void) 
+{
+  struct thread *t = thread_current ();
+
+  if (t->pages != NULL) 
+    {
+      hash_destroy (t->pages, destroy_page);
+      free (t->pages);
+      t->pages = NULL;
+    }
+}
+
+/* Returns a new zero-filled page at user virtual address UPAGE
+   in thread T's address space, writable by the user process if
+   WRITABLE is true, or a null pointer if memory allocation
+   fails.  The page is not in T's supplemental page table. */
+static struct page *
+new_page (struct thread *t, void *upage, bool writable) 
+{
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+
+  p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+
+  p->addr = upage;
+  p->writable = writable;
+  p->thread = t;
+  p->frame = NULL;
+  p->swap_slot = SWAP_SLOT_NONE;
+  p->file = NULL;
+  p->file_offset = 0;
+  p->file_bytes = 0;
+  p->private = true;
+  p->shared = NULL;
+  p->window = 1;
+  p->advice = MADV_NORMAL;
+  return p;
+}
+
+/* Adds page P, from new_page(), to its process's supplemental
+   page table, whose `pages_lock' the caller must hold, and
+   returns it.  Frees P and returns a null pointer if there is
+   already a page at its address. */
+static struct page *
+insert_page (struct page *p) 
+{
+  ASSERT (lock_held_by_current_thread (&p->thread->pages_lock));
+
+  if (hash_insert (p->thread->pages, &p->hash_elem) != NULL) 
+    {
+      free (p);
+      return NULL;
+    }
+  return p;
+}
+
+/* Adds page P, from new_page(), to its process's supplemental
+   page table, as insert_page() does, taking the table's lock. */
+static struct page *
+add_page (struct page *p) 
+{
+  struct lock *pages_lock;
+
+  if (p == NULL)
+    return NULL;
+  pages_lock = &p->thread->pages_lock;
+  lock_acquire (pages_lock);
+  p = insert_page (p);
+  lock_release (pages_lock);
+  return p;
+}
+
+/* Adds a zero-filled page at user virtual address UPAGE to the
+   running process's supplemental page table, writable by the
+   user process if WRITABLE is true.  While no other thread of
+   the process can be running, the caller may make the page
+   file-backed by filling in its `file' members; otherwise, use
+   page_allocate_mapped() or page_allocate_shared(), which have
+   the page complete before any thread can fault on it.
+   Returns the new page, or a null pointer if UPAGE is already
+   in the table or memory allocation fails. */
+struct page *
+page_allocate (void *upage, bool writable) 
+{
+  return add_page (new_page (process_current (), upage, writable));
+}
+
+/* Adds a writable page at user virtual address UPAGE to the
+   running process's supplemental page table, as page_allocate()
+   does, for a memory mapping of FILE: its first BYTES bytes are
+   read from FILE at OFFSET, and it is written back there. */
+struct page *
+page_allocate_mapped (void *upage, struct file *file, off_t offset,
+                      off_t bytes) 
+{
+  struct page *p = new_page (process_current (), upage, true);
+
+  if (p != NULL) 
+    {
+      p->file = file;
+      p->file_offset = offset;
+      p->file_bytes = bytes;
+      p->private = false;
+    }
+  return add_page (p);
+}
+
+/* Adds a writable page at user virtual address UPAGE to the
+   running process's supplemental page table, as page_allocate()
+   does, that maps SHARED, a page of a shared memory segment. */
+struct page *
+page_allocate_shared (void *upage, struct page *shared) 
+{
+  struct page *p = new_page (process_current (), upage, true);
+
+  if (p != NULL)
+    p->shared = shared;
+  return add_page (p);
+}
+
+/* Returns a new zero-filled page of a shared memory segment, at
+   UPAGE in the address space T that holds the segments' pages,
+   or a null pointer if memory allocation fails.  Processes map
+   the page through pages of their own whose `shared' member
+   points to it.  The page is not in any supplemental page table:
+   free it with page_destroy(). */
+struct page *
+page_create (struct thread *t, void *upage) 
+{
+  return new_page (t, upage, true);
+}
+
+/* Returns the page in thread T's supplemental page table that
+   contains ADDRESS, or a null pointer if there is none. */
+static struct page *
+find_page (struct thread *t, const void *address) 
+{
+  struct page p;
+  struct hash_elem *e;
+
+  p.addr = pg_round_down (address);
+  e = hash_find (t->pages, &p.hash_elem);
+  return e != NULL ? hash_entry (e, struct page, hash_elem) : NULL;
+}
+
+/* Returns true if an access to ADDRESS by the running thread,
+   which has no page there, should grow its stack: that is, if
+   ADDRESS is within the stack size limit of the top of user
+   memory and no lower than the stack pointer allows.  The
+   lowest address any instruction touches relative to the stack
+   pointer is 32 bytes below it, by PUSHA. */
+static bool
+is_stack_growth (const void *address) 
+{
+  const uint8_t *esp = thread_current ()->user_esp;
+
+  return ((const uint8_t *) address
+          >= (const uint8_t *) PHYS_BASE - stack_page_limit * PGSIZE)
+         && esp != NULL
+         && (const uint8_t *) address >= esp - 32;
+}
+
+/* Returns the page in the running process's supplemental page
+   table that contains ADDRESS, or a null pointer if there is
+   none.  If ADDRESS is just below the stack, then the stack
+   grows to include it: a new, zeroed page is added and
+   returned.  The caller must hold the process's `pages_lock'. */
+static struct page *
+page_for_addr (const void *address) 
+{
+  struct thread *t = process_current ();
+  struct page *p;
+
+  if (t->pages == NULL || !is_user_vaddr (address))
+    return NULL;
+
+  p = find_page (t, address);
+  if (p == NULL && is_stack_growth (address)) 
+    {
+      p = new_page (t, pg_round_down (address), true);
+      if (p != NULL)
+        p = insert_page (p);
+    }
+  return p;
+}
+
+/* Fills KPAGE, the frame of page P, with P's contents from
+   swap, from its file, or with zeros.
+   Returns true if successful, false on a read error. */
+static bool
+page_read (struct page *p, void *kpage) 
+{
+  off_t read_bytes = 0;
+
+  if (p->swap_slot != SWAP_SLOT_NONE) 
+    {
+      swap_in (p);
+      return true;
+    }
+  if (p->file != NULL) 
+    {
+      lock_acquire (&filesys_lock);
+      read_bytes = file_read_at (p->file, kpage, p->file_bytes,
+                                 p->file_offset);
+      lock_release (&filesys_lock);
+      if (read_bytes != p->file_bytes)
+        return false;
+    }
+  memset ((uint8_t *) kpage + read_bytes, 0, PGSIZE - read_bytes);
+  return true;
+}
+
+static bool page_lock_in (struct page *, bool write);
+
+/* Attaches page P, which maps shared memory, to the frame of the
+   segment page that it maps, first bringing that page into
+   memory if necessary.  Returns true if successful, false on
+   failure.
+
+   The segment page alone holds the segment's data, so P lets go
+   of any swap slot that it was given when the frame was last
+   evicted.  The processes that modified the frame may unmap it
+   before it is evicted again, taking their dirty bits with them,
+   so the segment page is always marked dirty. */
+static bool
+do_share_in (struct page *p) 
+{
+  struct page *sp = p->shared;
+  bool success;
+
+  lock_acquire (&shared_lock);
+  success = page_lock_in (sp, true);
+  lock_release (&shared_lock);
+  if (!success)
+    return false;
+
+  pagedir_set_dirty (sp->thread->pagedir, sp->addr, true);
+  swap_discard (p);
+  frame_attach (sp->frame, p);
+  return true;
+}
+
+/* Allocates a frame for page P and fills it with the page's
+   contents.  WRITE is true if P is being brought in to be
+   written.  Returns true if successful, false on failure. */
+static bool
+do_page_in (struct page *p, bool write) 
+{
+  struct frame *f;
+  bool found = false;
+
+  if (p->shared != NULL)
+    return do_share_in (p);
+
+  /* A zero-filled page that is only being read maps the zero
+     frame, so that memory that is never written takes none of
+     its own.  Writing to it later copies it, like any other
+     shared frame. */
+  if (p->file == NULL && p->swap_slot == SWAP_SLOT_NONE && !write) 
+    {
+      frame_attach (frame_lock_zero (), p);
+      return true;
+    }
+
+  /* A read-only page of an executable can share its frame with
+     the same page in every other process that runs it. */
+  if (p->file != NULL && !p->writable && p->private
+      && p->swap_slot == SWAP_SLOT_NONE)
+    f = frame_alloc_shared (p, file_get_inode (p->file), p->file_offset,
+                            p->file_bytes, &found);
+  else 
+    {
+      f = frame_alloc_and_lock ();
+      if (f != NULL)
+        frame_attach (f, p);
+    }
+  if (f == NULL)
+    return false;
+
+  if (!found && !page_read (p, f->base)) 
+    {
+      frame_detach (p);
+      frame_free (f);
+      return false;
+    }
+  return true;
+}
+
+/* Maps page P into its thread's page directory, at its frame.
+   A frame shared with another page is mapped read-only, even if
+   P is writable, so that writing to it faults and gives P a
+   copy of its own, unless P maps shared memory.  Returns true if
+   successful, false if memory for the page table is not
+   available. */
+static bool
+map_page (struct page *p) 
+{
+  return pagedir_set_page (p->thread->pagedir, p->addr, p->frame->base,
+                           p->writable && (p->frame->ref_cnt == 1
+                                           || p->shared != NULL));
+}
+
+/* Locks page P's frame into memory, first bringing P into a
+   frame and mapping it into its thread's page directory if it
+   is not in memory.  WRITE is true if P is being brought in to
+   be written.  Returns true if successful, in which case P's
+   frame is locked by the current thread, or false if P cannot be
+   brought in. */
+static bool
+page_lock_in (struct page *p, bool write) 
+{
+  uint32_t *pd = p->thread->pagedir;
+  bool from_swap;
+
+  frame_lock (p);
+  if (p->frame != NULL)
+    return true;
+
+  from_swap = p->swap_slot != SWAP_SLOT_NONE;
+  if (!do_page_in (p, write))
+    return false;
+
+  /* Install frame into page table. */
+  if (!map_page (p)) 
+    {
+      frame_release (p);
+      return false;
+    }
+
+  /* Reading a page back in gives up its swap slot, so the frame
+     holds the only copy.  Mark it dirty, so that evicting it
+     writes it out again even if it is not modified. */
+  if (from_swap)
+    pagedir_set_dirty (pd, p->addr, true);
+  return true;
+}
+
+/* Returns true if page Q holds the file data that follows
+   page P's in the same file, so that a fault on P may bring in
+   Q too.  A page that has been swapped out no longer matches its
+   file, so it does not count. */
+static bool
+is_file_successor (const struct page *p, const struct page *q) 
+{
+  return (q != NULL
+          && q->file == p->file
+          && q->private == p->private
+          && q->file_offset == p->file_offset + PGSIZE
+          && q->swap_slot == SWAP_SLOT_NONE);
+}
+
+/* Sets the fault-around window for file-backed page P, which
+   just faulted.  If the page before P, with the file data just
+   before P's, is in memory, then the process is likely reading
+   the file sequentially, so the window doubles from that page's,
+   up to the limit.  Otherwise, it falls back to 2 pages: P and
+   the page after it. */
+static void
+size_window (struct page *p) 
+{
+  struct page *prev = find_page (p->thread, (uint8_t *) p->addr - PGSIZE);
+
+  /* PREV->frame is read without locking PREV's frame, since it
+     only serves as a hint. */
+  if (prev != NULL && is_file_successor (prev, p) && prev->frame != NULL)
+    p->window = prev->window * 2;
+  else
+    p->window = 2;
+  if (p->window > fault_around_limit)
+    p->window = fault_around_limit;
+}
+
+/* Returns true if page Q is the page after page P in a region
+   that the process said it will access sequentially, with
+   contents: a fault on P then brings in Q too, whether it is
+   file-backed or anonymous and in swap.  Q->frame is only a hint
+   here, as in size_window(). */
+static bool
+is_sequential_successor (const struct page *p, const struct page *q) 
+{
+  return (q != NULL
+          && q->advice == MADV_SEQUENTIAL
+          && q->addr == (uint8_t *) p->addr + PGSIZE
+          && (q->file != NULL || q->swap_slot != SWAP_SLOT_NONE
+              || q->frame != NULL));
+}
+
+/* Clears the accessed bits of the pages in the fault-around
+   window before the last one behind page P, which just faulted
+   in a region that the process said it will access sequentially.
+   The process is done with those pages, so this makes them the
+   clock's first choice for eviction. */
+static void
+drop_behind (struct page *p) 
+{
+  size_t i;
+
+  for (i = p->window + 1; i <= 2 * p->window; i++) 
+    {
+      struct page *q;
+
+      if ((uintptr_t) p->addr < i * PGSIZE)
+        break;
+      q = find_page (p->thread, (uint8_t *) p->addr - i * PGSIZE);
+      if (q == NULL || q->advice != MADV_SEQUENTIAL)
+        break;
+      pagedir_set_accessed (p->thread->pagedir, q->addr, false);
+    }
+}
+
+/* Brings in the file-backed pages that follow page P, which
+   just faulted, in the same file, up to P's fault-around window,
+   so that a process reading the file sequentially takes one trap
+   per window rather than one per page.  Each page that is
+   already in the share table is simply mapped; the others are
+   read in one after another.  The pages brought in this way are
+   not marked accessed, so the clock evicts them early if the
+   process does not get to them.
+
+   madvise() hints change this.  In a region to be accessed
+   randomly, nothing is brought in around a fault.  In a region
+   to be accessed sequentially, the window starts out at the
+   limit, includes anonymous pages in swap, and the pages well
+   behind the fault are marked for early eviction. */
+static void
+fault_around (struct page *p) 
+{
+  bool sequential = p->advice == MADV_SEQUENTIAL;
+  struct page *q;
+  size_t i;
+
+  if (p->advice == MADV_RANDOM || fault_around_limit <= 1)
+    return;
+  if (sequential) 
+    {
+      p->window = fault_around_limit;
+      drop_behind (p);
+    }
+  else if (p->file != NULL)
+    size_window (p);
+  else
+    return;
+
+  for (i = 1, q = p; i < p->window; i++) 
+    {
+      struct page *next = find_page (p->thread, (uint8_t *) q->addr + PGSIZE);
+      if (sequential
+          ? !is_sequential_successor (q, next)
+          : !is_file_successor (q, next))
+        break;
+
+      q = next;
+      q->window = p->window;
+      if (!page_lock_in (q, false))
+        break;
+      frame_unlock (q->frame);
+    }
+}
+
+/* Brings the page containing FAULT_ADDR into memory and maps it
+   into the running thread's page directory.  WRITE is true if
+   the fault was a write.  If the page is backed by a file,
+   brings in some of the pages after it, too.  Returns true if
+   successful, false if FAULT_ADDR is not in the supplemental
+   page table or the page cannot be brought in.
+
+   The threads of a process take their faults one at a time, so
+   that no two of them bring in the same page at once. */
+bool
+page_in (void *fault_addr, bool write) 
+{
+  struct lock *pages_lock = &process_current ()->pages_lock;
+  struct page *p;
+  bool success = false;
+
+  lock_acquire (pages_lock);
+  p = page_for_addr (fault_addr);
+  if (p != NULL && page_lock_in (p, write)) 
+    {
+      frame_unlock (p->frame);
+      fault_around (p);
+      success = true;
+    }
+  lock_release (pages_lock);
+  return success;
+}
+
+/* Makes writable page P, whose frame must be locked by the
+   current thread, writable in its page directory as well.  If
+   the frame is shared, P first gets a copy of its own, which is
+   returned locked in place of the original, unless P maps
+   shared memory.  Returns true if successful, false if no frame
+   is available for the copy. */
+static bool
+make_writable (struct page *p) 
+{
+  uint32_t *pd = p->thread->pagedir;
+  struct frame *old = p->frame;
+  struct frame *new;
+
+  ASSERT (p->writable);
+  ASSERT (lock_held_by_current_thread (&old->lock));
+
+  if (old->ref_cnt == 1 || p->shared != NULL) 
+    {
+      pagedir_set_writable (pd, p->addr, true);
+      return true;
+    }
+
+  new = frame_alloc_and_lock ();
+  if (new == NULL)
+    return false;
+  memcpy (new->base, old->base, PGSIZE);
+
+  pagedir_clear_page (pd, p->addr);
+  frame_detach (p);
+  frame_unlock (old);
+  frame_attach (new, p);
+  if (!map_page (p))
+    NOT_REACHED ();
+
+  /* The copy no longer matches whatever backs the page. */
+  pagedir_set_dirty (pd, p->addr, true);
+  return true;
+}
+
+/* Handles a write by the running thread to the page containing
+   FAULT_ADDR, which is mapped read-only because it shares its
+   frame copy-on-write.  Gives the page its own copy of the
+   frame, if it is still shared, and makes it writable.  Returns
+   true if successful, false if the page is not writable or no
+   frame is available. */
+bool
+page_unshare (void *fault_addr) 
+{
+  struct lock *pages_lock = &process_current ()->pages_lock;
+  struct page *p;
+  bool success = false;
+
+  lock_acquire (pages_lock);
+  p = page_for_addr (fault_addr);
+  if (p != NULL && p->writable && page_lock_in (p, true)) 
+    {
+      success = make_writable (p);
+      frame_unlock (p->frame);
+    }
+  lock_release (pages_lock);
+  return success;
+}
+
+/* Brings the page containing ADDR into memory, if necessary, and
+   locks it there, so that the kernel can access it without
+   faulting, e.g. while it holds a lock that page_in() needs.
+   If WILL_WRITE is true, the page must be writable, and it is
+   unshared first.  Returns the locked page if successful, or a
+   null pointer if ADDR is not a valid user address for the
+   access.  Undo with page_unlock(). */
+struct page *
+page_lock (const void *addr, bool will_write) 
+{
+  struct lock *pages_lock = &process_current ()->pages_lock;
+  struct page *p;
+
+  lock_acquire (pages_lock);
+  p = page_for_addr (addr);
+  if (p != NULL
+      && ((!p->writable && will_write) || !page_lock_in (p, will_write)))
+    p = NULL;
+  if (p != NULL && will_write && !make_writable (p)) 
+    {
+      frame_unlock (p->frame);
+      p = NULL;
+    }
+  lock_release (pages_lock);
+  return p;
+}
+
+/* Unlocks page P, which must have been locked with page_lock().
+   Another thread of the process may be waiting to free P, so P
+   is not looked up again. */
+void
+page_unlock (struct page *p) 
+{
+  ASSERT (p->frame != NULL);
+  frame_unlock (p->frame);
+}
+
+/* Frees page P's frame or swap slot, if any, writing P back to
+   its file first if it is a shared file mapping that has been
+   modified.  P is then as it was before it was first accessed:
+   zero-filled, or to be read from its file. */
+static void
+page_drop (struct page *p) 
+{
+  frame_lock (p);
+  if (p->frame != NULL) 
+    {
+      struct frame *f = p->frame;
+
+      if (p->private) 
+        {
+          pagedir_clear_page (p->thread->pagedir, p->addr);
+          frame_release (p);
+        }
+      else 
+        {
+          page_out (p);
+          frame_free (f);
+        }
+    }
+  swap_discard (p);
+}
+
+/* Frees page P, a page of a shared memory segment created with
+   page_create(), and the frame or swap slot that holds it.  No
+   process may map P any longer. */
+void
+page_destroy (struct page *p) 
+{
+  page_drop (p);
+  free (p);
+}
+
+/* Removes the page containing VADDR from the running thread's
+   supplemental page table, writing it back to its file first if
+   it is a shared file mapping that has been modified. */
+void
+page_deallocate (void *vaddr) 
+{
+  struct thread *t = process_current ();
+  struct page *p;
+
+  lock_acquire (&t->pages_lock);
+  p = find_page (t, vaddr);
+  ASSERT (p != NULL);
+  page_drop (p);
+  hash_delete (t->pages, &p->hash_elem);
+  lock_release (&t->pages_lock);
+  free (p);
+}
+
+/* Applies ADVICE, one of the MADV_* values, to the pages in the
+   LENGTH bytes starting at ADDR in the running thread's address
+   space:
+
+     - MADV_NORMAL, MADV_RANDOM, and MADV_SEQUENTIAL describe how
+       the process will access the pages, which tunes how many
+       pages a fault brings in around the faulting page.  See
+       fault_around().
+
+     - MADV_WILLNEED brings the pages into memory now, so that
+       the process does not fault on them later.
+
+     - MADV_DONTNEED frees the pages' frames and swap slots right
+       away.  Later accesses find the pages zero-filled, or as
+       they are in their files, except that the modifications to
+       a shared file mapping are written back first.  Shared
+       memory keeps its contents: a page of it is only unmapped.
+
+   ADDR must be page-aligned, and every page in the range must
+   be in the supplemental page table.  Returns true if
+   successful, false if the arguments are invalid, in which case
+   no page is affected. */
+bool
+page_advise (void *addr, size_t length, int advice) 
+{
+  struct thread *t = process_current ();
+  uint8_t *start = addr;
+  uint8_t *end;
+  uint8_t *upage;
+
+  if (pg_ofs (addr) != 0 || !is_user_vaddr (addr)
+      || length > (size_t) ((uint8_t *) PHYS_BASE - start)
+      || advice < MADV_NORMAL || advice > MADV_DONTNEED)
+    return false;
+  end = start + ROUND_UP (length, PGSIZE);
+
+  lock_acquire (&t->pages_lock);
+  for (upage = start; upage < end; upage += PGSIZE)
+    if (find_page (t, upage) == NULL) 
+      {
+        lock_release (&t->pages_lock);
+        return false;
+      }
+
+  for (upage = start; upage < end; upage += PGSIZE) 
+    {
+      struct page *p = find_page (t, upage);
+
+      switch (advice) 
+        {
+        case MADV_NORMAL:
+        case MADV_RANDOM:
+        case MADV_SEQUENTIAL:
+          p->advice = advice;
+          p->window = 1;
+          break;
+
+        case MADV_WILLNEED:
+          /* A page with no contents yet has nothing to read, and
+             running out of memory just cuts the prefetch short. */
+          if (p->file == NULL && p->swap_slot == SWAP_SLOT_NONE)
+            break;
+          if (!page_lock_in (p, false))
+            goto done;
+          frame_unlock (p->frame);
+          break;
+
+        case MADV_DONTNEED:
+          page_drop (p);
+          break;
+        }
+    }
+
+ done:
+  lock_release (&t->pages_lock);
+  return true;
+}
+
+/* Maps the pages of frame F, which were unmapped for eviction,
+   back into it, because it could not be written out after all. */
+static void
+frame_restore (struct frame *f) 
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e)) 
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+
+      map_page (p);
+      pagedir_set_dirty (p->thread->pagedir, p->addr, true);
+    }
+}
+
+/* Detaches all of the pages from frame F, whose contents are no
+   longer needed. */
+static void
+frame_empty (struct frame *f) 
+{
+  while (!list_empty (&f->pages))
+    frame_detach (list_entry (list_front (&f->pages),
+                              struct page, frame_elem));
+}
+
+/* Writes page P, a modified page of a shared file mapping, back
+   to its file. */
+static void
+page_write_back (struct page *p) 
+{
+  lock_acquire (&filesys_lock);
+  file_write_at (p->file, p->frame->base, p->file_bytes, p->file_offset);
+  lock_release (&filesys_lock);
+}
+
+/* Evicts the pages in the CNT frames in FRAMES[], each of which
+   must be locked by the current thread.  Afterward, each frame
+   that was evicted has no pages; any other frame keeps its
+   pages and their mappings.
+
+   A frame whose contents have not changed since they were read
+   in can simply be dropped, because page_in() can read or zero
+   them again.  A modified page of a shared file mapping is
+   written back to its file.  The other modified frames are
+   written to swap together, in one contiguous run if possible;
+   pages that share a frame share its swap slot, too.  Such a
+   frame stays in memory only if swap is full. */
+void
+page_out_cluster (struct frame *frames[], size_t cnt) 
+{
+  struct frame *dirty[SWAP_CLUSTER];
+  size_t dirty_cnt = 0;
+  size_t i;
+
+  ASSERT (cnt <= SWAP_CLUSTER);
+
+  for (i = 0; i < cnt; i++) 
+    {
+      struct frame *f = frames[i];
+      struct page *first;
+      struct list_elem *e;
+      bool is_dirty = false;
+
+      ASSERT (lock_held_by_current_thread (&f->lock));
+      ASSERT (f->ref_cnt > 0);
+
+      /* Mark pages not present in their page tables, forcing
+         accesses by their processes to fault.  This must happen
+         before checking the dirty bits, to prevent a race with
+         a process dirtying the frame. */
+      for (e = list_begin (&f->pages); e != list_end (&f->pages);
+           e = list_next (e)) 
+        {
+          struct page *p = list_entry (e, struct page, frame_elem);
+          uint32_t *pd = p->thread->pagedir;
+
+          pagedir_clear_page (pd, p->addr);
+          if (pagedir_is_dirty (pd, p->addr))
+            is_dirty = true;
+        }
+
+      first = list_entry (list_front (&f->pages), struct page, frame_elem);
+      ASSERT (first->private || f->ref_cnt == 1);
+      if (!is_dirty)
+        frame_empty (f);
+      else if (!first->private) 
+        {
+          page_write_back (first);
+          frame_empty (f);
+        }
+      else
+        dirty[dirty_cnt++] = f;
+    }
+
+  swap_out_cluster (dirty, dirty_cnt);
+  for (i = 0; i < dirty_cnt; i++) 
+    {
+      struct page *first = list_entry (list_front (&dirty[i]->pages),
+                                       struct page, frame_elem);
+      if (first->swap_slot != SWAP_SLOT_NONE)
+        frame_empty (dirty[i]);
+      else
+        frame_restore (dirty[i]);
+    }
+}
+
+/* Evicts page P from its frame, along with any pages that share
+   the frame.  P must have a frame, locked by the current thread.
+   Returns true if successful, in which case P no longer has a
+   frame, or false on failure, in which case P keeps its frame
+   and mapping. */
+bool
+page_out (struct page *p) 
+{
+  struct frame *f = p->frame;
+
+  page_out_cluster (&f, 1);
+  return p->frame == NULL;
+}
+
+/* Returns true if page P's data has been accessed recently,
+   false otherwise, and clears P's accessed bit, so that the
+   clock gives P a second chance only once.
+   P must have a frame locked into memory. */
+bool
+page_accessed_recently (struct page *p) 
+{
+  uint32_t *pd = p->thread->pagedir;
+  bool was_accessed;
+
+  ASSERT (p->frame != NULL);
+  ASSERT (lock_held_by_current_thread (&p->frame->lock));
+
+  was_accessed = pagedir_is_accessed (pd, p->addr);
+  if (was_accessed)
+    pagedir_set_accessed (pd, p->addr, false);
+  return was_accessed;
+}
+
+/* Returns true if page P has been modified since it was brought
+   into its frame.  P must have a frame locked into memory. */
+bool
+page_is_dirty (struct page *p) 
+{
+  ASSERT (p->frame != NULL);
+  ASSERT (lock_held_by_current_thread (&p->frame->lock));
+
+  return pagedir_is_dirty (p->thread->pagedir, p->addr);
+}
+
+/* Returns a hash value for the page that P refers to. */
+static unsigned
+page_hash (const struct hash_elem *p_, void *aux UNUSED) 
+{
+  const struct page *p = hash_entry (p_, struct page, hash_elem);
+  return hash_bytes (&p->addr, sizeof p->addr);
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED) 
+{
+  const struct page *a = hash_entry (a_, struct page, hash_elem);
+  const struct page *b = hash_entry (b_, struct page, hash_elem);
+
+  return a->addr < b->addr;
+}
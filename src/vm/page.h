@@ -0,0 +1,112 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include "filesys/off_t.h"
+
+/* A user virtual page in the supplemental page table.
+
+   Records where the page's contents come from, so that the page
+   can be brought into memory the first time it is accessed
+   rather than when the process is loaded.  A page is file-backed
+   if FILE is nonnull, in which case its first FILE_BYTES bytes
+   are read from FILE at FILE_OFFSET and the rest are zeroed.
+   Otherwise, the page is zero-filled.  Once a page has been
+   modified, evicting it writes it to swap, and SWAP_SLOT records
+   where until it is read back in, unless PRIVATE is false: then
+   the page belongs to a memory-mapped file and is written back
+   to FILE instead.
+
+   While the page is in memory, FRAME points to the frame that
+   holds it.  FRAME is set only by a thread of the owning process
+   holding the process's `pages_lock', with the frame locked, and
+   cleared with the frame locked when the page is evicted or
+   freed.  (fork() sets the child's FRAME members, before the
+   child runs.)
+
+   A writable page may share its frame, and its swap slot, with
+   the corresponding page of a parent or child process, and a
+   zero-filled page that has only been read maps the zero frame.
+   Shared frames are mapped read-only, and the first write to one
+   gives the writer a copy of its own.
+
+   A page of a shared memory mapping is the exception: it maps
+   SHARED, a page that belongs to the segment rather than to any
+   process, whose frame and swap slot hold the segment's data.
+   While SHARED is in memory, each page that maps it shares its
+   frame, writable in place. */
+struct page 
+  {
+    /* Immutable members. */
+    void *addr;                 /* User virtual address. */
+    bool writable;              /* Writable by the user process? */
+    struct thread *thread;      /* Owning process's first thread. */
+
+    /* Protected by the owning process's `pages_lock'. */
+    struct hash_elem hash_elem; /* Element in thread's `pages'. */
+
+    /* Frame holding the page, if it is in memory. */
+    struct frame *frame;        /* Frame, or a null pointer. */
+    struct list_elem frame_elem; /* Element in frame's `pages'. */
+
+    /* Swap information, protected by frame->lock. */
+    size_t swap_slot;           /* Swap slot, or SWAP_SLOT_NONE. */
+
+    /* Backing file, if any. */
+    struct file *file;          /* File, or a null pointer. */
+    off_t file_offset;          /* Offset of page's data in FILE. */
+    off_t file_bytes;           /* Bytes to read from FILE, 0...PGSIZE. */
+    bool private;               /* False to write back to FILE. */
+    struct page *shared;        /* Shared memory page, or null. */
+    size_t window;              /* Fault-around window, in pages. */
+    int advice;                 /* MADV_* access pattern hint. */
+  };
+
+/* Default limit on the size of a user stack, in pages. */
+#define STACK_PAGES_DEFAULT 2048
+
+/* Maximum size of a user stack, in pages.  Set by the -sl
+   kernel command-line option. */
+extern size_t stack_page_limit;
+
+/* User stacks for the threads that a process creates beyond its
+   first, which lie one after another below the region reserved
+   for the first thread's stack: at most THREAD_STACK_CNT of them
+   at once, each THREAD_STACK_PAGES pages long. */
+#define THREAD_STACK_CNT 32
+#define THREAD_STACK_PAGES 16
+
+/* Default limit on the number of file-backed pages brought in by
+   one page fault. */
+#define FAULT_AROUND_DEFAULT 8
+
+/* Maximum number of file-backed pages brought in by one page
+   fault, counting the faulting page.  Set by the -fa kernel
+   command-line option; 1 disables fault-around. */
+extern size_t fault_around_limit;
+
+void page_init (void);
+bool page_table_create (void);
+bool page_table_copy (struct thread *parent);
+void page_exit (void);
+
+struct page *page_allocate (void *upage, bool writable);
+struct page *page_allocate_mapped (void *upage, struct file *,
+                                   off_t offset, off_t bytes);
+struct page *page_allocate_shared (void *upage, struct page *shared);
+struct page *page_create (struct thread *, void *upage);
+void page_destroy (struct page *);
+void page_deallocate (void *vaddr);
+bool page_advise (void *addr, size_t length, int advice);
+bool page_in (void *fault_addr, bool write);
+bool page_unshare (void *fault_addr);
+struct page *page_lock (const void *addr, bool will_write);
+void page_unlock (struct page *);
+bool page_out (struct page *);
+void page_out_cluster (struct frame *[], size_t cnt);
+bool page_accessed_recently (struct page *);
+bool page_is_dirty (struct page *);
+
+#endif /* vm/page.h */
@@ -0,0 +1,190 @@
+#include "vm/shm.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <list.h>
+#include <stdint.h>
+#include <string.h>
+#include "vm/page.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+
+/* A shared memory segment.
+
+   A segment is a named run of pages of anonymous memory that any
+   number of processes may map at once, each seeing what the
+   others write.  The segment's own pages hold its data.  They
+   live in an address space of their own, in which no process
+   runs, and they are brought in, evicted to swap, and read back
+   like the pages of any process's anonymous memory.  The pages
+   of a process's mapping just point to them: see struct page.
+
+   The first mapping of a segment creates it, later mappings find
+   it by name, and it is freed along with its data when its last
+   mapping goes away. */
+struct shm
+  {
+    struct list_elem elem;      /* Element in `segments'. */
+    char name[SHM_NAME_MAX + 1]; /* Name. */
+    int ref_cnt;                /* Number of mappings. */
+    size_t start;               /* Index of first page in address space. */
+    size_t page_cnt;            /* Number of pages. */
+    struct page *pages[];       /* Pages, each null until created. */
+  };
+
+/* Existing segments, and the pages of the segments' address
+   space that they use, protected by shm_lock. */
+static struct list segments;
+static struct bitmap *used_pages;
+static struct lock shm_lock;
+
+/* Owner of the segments' pages.  Only its page directory is
+   used, to hold the pages' mappings, which give the clock
+   accessed and dirty bits to examine as for any other page. */
+static struct thread shm_space;
+
+/* Initializes the shared memory segment table. */
+void
+shm_init (void)
+{
+  list_init (&segments);
+  lock_init (&shm_lock);
+  used_pages = bitmap_create (SHM_PAGES_MAX);
+  shm_space.pagedir = pagedir_create ();
+  if (used_pages == NULL || shm_space.pagedir == NULL)
+    PANIC ("shm_init: out of memory");
+}
+
+/* Returns the address of page IDX of the segments' address
+   space.  Page 0 of the address space is never used. */
+static void *
+space_addr (size_t idx)
+{
+  return (uint8_t *) PGSIZE + idx * PGSIZE;
+}
+
+/* Frees segment SHM and its pages, along with the frames and
+   swap slots that hold them.  The caller must hold shm_lock. */
+static void
+destroy (struct shm *shm)
+{
+  size_t i;
+
+  for (i = 0; i < shm->page_cnt; i++)
+    if (shm->pages[i] != NULL)
+      page_destroy (shm->pages[i]);
+  bitmap_set_multiple (used_pages, shm->start, shm->page_cnt, false);
+  free (shm);
+}
+
+/* Creates and returns a segment named NAME with PAGE_CNT
+   zero-filled pages and a single reference, or returns a null
+   pointer if memory or room in the segments' address space is
+   not available.  The caller must hold shm_lock. */
+static struct shm *
+create (const char *name, size_t page_cnt)
+{
+  struct shm *shm;
+  size_t i;
+
+  if (page_cnt > SHM_PAGES_MAX)
+    return NULL;
+  shm = calloc (1, sizeof *shm + page_cnt * sizeof *shm->pages);
+  if (shm == NULL)
+    return NULL;
+  shm->start = bitmap_scan_and_flip (used_pages, 0, page_cnt, false);
+  if (shm->start == BITMAP_ERROR)
+    {
+      free (shm);
+      return NULL;
+    }
+  strlcpy (shm->name, name, sizeof shm->name);
+  shm->ref_cnt = 1;
+  shm->page_cnt = page_cnt;
+
+  for (i = 0; i < page_cnt; i++)
+    {
+      shm->pages[i] = page_create (&shm_space, space_addr (shm->start + i));
+      if (shm->pages[i] == NULL)
+        {
+          destroy (shm);
+          return NULL;
+        }
+    }
+  list_push_back (&segments, &shm->elem);
+  return shm;
+}
+
+/* Returns the segment named NAME with a new reference, creating
+   it with PAGE_CNT zero-filled pages if there is none.  An
+   existing segment must have at least PAGE_CNT pages.  Returns a
+   null pointer if NAME is empty or longer than SHM_NAME_MAX, if
+   PAGE_CNT is 0 or more than the existing segment has, or if
+   memory is not available.  Undo with shm_close(). */
+struct shm *
+shm_open (const char *name, size_t page_cnt)
+{
+  size_t name_len = strnlen (name, SHM_NAME_MAX + 1);
+  struct list_elem *e;
+  struct shm *shm = NULL;
+
+  if (name_len == 0 || name_len > SHM_NAME_MAX || page_cnt == 0)
+    return NULL;
+
+  lock_acquire (&shm_lock);
+  for (e = list_begin (&segments); e != list_end (&segments);
+       e = list_next (e))
+    {
+      struct shm *s = list_entry (e, struct shm, elem);
+      if (!strcmp (s->name, name))
+        {
+          shm = s;
+          break;
+        }
+    }
+  if (shm == NULL)
+    shm = create (name, page_cnt);
+  else if (shm->page_cnt >= page_cnt)
+    shm->ref_cnt++;
+  else
+    shm = NULL;
+  lock_release (&shm_lock);
+
+  return shm;
+}
+
+/* Adds a reference to SHM and returns it. */
+struct shm *
+shm_reopen (struct shm *shm)
+{
+  lock_acquire (&shm_lock);
+  ASSERT (shm->ref_cnt > 0);
+  shm->ref_cnt++;
+  lock_release (&shm_lock);
+  return shm;
+}
+
+/* Drops a reference to SHM, freeing it and its data when none
+   remain.  No process may map the segment's pages by then. */
+void
+shm_close (struct shm *shm)
+{
+  lock_acquire (&shm_lock);
+  ASSERT (shm->ref_cnt > 0);
+  if (--shm->ref_cnt == 0)
+    {
+      list_remove (&shm->elem);
+      destroy (shm);
+    }
+  lock_release (&shm_lock);
+}
+
+/* Returns page IDX of SHM, for a process's page to map. */
+struct page *
+shm_page (struct shm *shm, size_t idx)
+{
+  ASSERT (idx < shm->page_cnt);
+  return shm->pages[idx];
+}
@@ -0,0 +1,21 @@
+#ifndef VM_SHM_H
+#define VM_SHM_H
+
+#include <stddef.h>
+
+struct page;
+
+/* Maximum length of a shared memory segment's name. */
+#define SHM_NAME_MAX 31
+
+/* Maximum number of pages in all shared memory segments
+   together. */
+#define SHM_PAGES_MAX 16384
+
+void shm_init (void);
+struct shm *shm_open (const char *name, size_t page_cnt);
+struct shm *shm_reopen (struct shm *);
+void shm_close (struct shm *);
+struct page *shm_page (struct shm *, size_t idx);
+
+#endif /* vm/shm.h */
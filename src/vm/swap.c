@@ -0,0 +1,529 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <list.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "vm/frame.h"
+#include "vm/lz.h"
+#include "vm/page.h"
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* The swap device. */
+static struct block *swap_device;
+
+/* Used disk slots, one bit per page-sized slot. */
+static struct bitmap *swap_bitmap;
+
+/* Number of pages that refer to each swap slot.  A slot is
+   shared by the pages that shared a frame when it was written
+   out, and freed when the last of them lets go of it. */
+static uint16_t *swap_refs;
+
+/* Slot at which to start looking for free slots.  Allocating
+   upward from the last allocation keeps successive clusters
+   adjacent on disk, too. */
+static size_t next_slot;
+
+/* Compressed swap cache.
+
+   Writing a page to the swap disk and reading it back are slow,
+   so a page that compresses well is kept in memory in compressed
+   form instead, until the cache grows past its limit and the
+   page "spills" to disk, least recently used pages first.  A
+   page that compresses to more than half its size is not worth
+   caching and goes straight to disk.
+
+   Slot numbers below the number of slots on the swap disk name
+   disk slots.  Those from there up name cache slots, which are
+   not limited by the size of the disk, so that the cache works
+   even without a swap device.  A cached page takes a disk slot
+   only when it spills, keeping its cache slot, which the pages
+   that refer to it still use, with just a small header left in
+   memory. */
+struct zpage 
+  {
+    struct list_elem elem;      /* Element in `zpage_list', if in RAM. */
+    unsigned ref_cnt;           /* Number of pages that refer to it. */
+    size_t disk_slot;           /* Disk slot once spilled. */
+    bool spilling;              /* Being written to DISK_SLOT? */
+    size_t size;                /* Size of compressed data. */
+    uint8_t *data;              /* Compressed data, null once spilled. */
+  };
+
+/* Maximum size of compressed data worth caching. */
+#define ZPAGE_MAX (PGSIZE / 2)
+
+/* Maximum number of pages of memory to use for the compressed
+   swap cache. */
+size_t swap_cache_limit = SWAP_CACHE_DEFAULT;
+
+/* Number of disk slots, which is also the first cache slot. */
+static size_t disk_slot_cnt;
+
+/* Page for each cache slot, starting from DISK_SLOT_CNT, or a
+   null pointer if the slot is free.  Grows as needed. */
+static struct zpage **zslots;
+static size_t zslot_cnt;        /* Number of elements in ZSLOTS. */
+static size_t next_zslot;       /* Where to look for a free one. */
+
+/* Cached pages in memory, most recently used first. */
+static struct list zpage_list;
+
+/* Number of bytes of memory used by cached pages in memory. */
+static size_t cache_bytes;
+
+/* Scratch buffers for compressing, and for decompressing a page
+   to spill. */
+static uint8_t compress_buf[ZPAGE_MAX];
+static uint8_t spill_buf[PGSIZE];
+
+/* Statistics. */
+static long long compressed_cnt;    /* # of pages cached. */
+static long long compressed_bytes;  /* Total size of cached pages. */
+static long long uncompressed_cnt;  /* # of pages written to disk. */
+static long long hit_cnt;           /* # of swap-ins from the cache. */
+static long long miss_cnt;          /* # of swap-ins from disk. */
+static long long spill_cnt;         /* # of cached pages spilled. */
+
+/* Protects SWAP_BITMAP, SWAP_REFS, NEXT_SLOT, and the swap
+   cache, including COMPRESS_BUF and the pages' reference
+   counts. */
+static struct lock swap_lock;
+
+/* Allows only one thread at a time to spill, and protects
+   SPILL_BUF.  Never acquired while holding swap_lock. */
+static struct lock spill_lock;
+
+/* Number of sectors per page. */
+#define PAGE_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Sets up swap. */
+void
+swap_init (void) 
+{
+  swap_device = block_get_role (BLOCK_SWAP);
+  if (swap_device == NULL) 
+    {
+      printf ("no swap device--swap disabled\n");
+      swap_bitmap = bitmap_create (0);
+    }
+  else
+    swap_bitmap = bitmap_create (block_size (swap_device) / PAGE_SECTORS);
+  if (swap_bitmap == NULL)
+    PANIC ("couldn't create swap bitmap");
+  disk_slot_cnt = bitmap_size (swap_bitmap);
+  swap_refs = calloc (disk_slot_cnt, sizeof *swap_refs);
+  if (swap_refs == NULL && disk_slot_cnt > 0)
+    PANIC ("couldn't create swap tables");
+  list_init (&zpage_list);
+  lock_init (&swap_lock);
+  lock_init (&spill_lock);
+}
+
+/* Allocates CNT contiguous disk slots and returns the first, or
+   BITMAP_ERROR if there is no run of CNT free slots. */
+static size_t
+alloc_slots (size_t cnt) 
+{
+  size_t slot;
+
+  ASSERT (lock_held_by_current_thread (&swap_lock));
+
+  slot = bitmap_scan_and_flip (swap_bitmap, next_slot, cnt, false);
+  if (slot == BITMAP_ERROR && next_slot != 0)
+    slot = bitmap_scan_and_flip (swap_bitmap, 0, cnt, false);
+  if (slot != BITMAP_ERROR)
+    next_slot = slot + cnt;
+  return slot;
+}
+
+/* Enters Z in a free cache slot and returns the slot, or
+   SWAP_SLOT_NONE if memory is not available. */
+static size_t
+alloc_zslot (struct zpage *z) 
+{
+  struct zpage **new_zslots;
+  size_t new_cnt;
+  size_t idx;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&swap_lock));
+
+  for (i = 0; i < zslot_cnt; i++) 
+    {
+      idx = (next_zslot + i) % zslot_cnt;
+      if (zslots[idx] == NULL)
+        goto found;
+    }
+
+  /* All in use.  Double the table. */
+  new_cnt = zslot_cnt > 0 ? zslot_cnt * 2 : 64;
+  new_zslots = realloc (zslots, new_cnt * sizeof *zslots);
+  if (new_zslots == NULL)
+    return SWAP_SLOT_NONE;
+  for (i = zslot_cnt; i < new_cnt; i++)
+    new_zslots[i] = NULL;
+  zslots = new_zslots;
+  idx = zslot_cnt;
+  zslot_cnt = new_cnt;
+
+ found:
+  zslots[idx] = z;
+  next_zslot = idx + 1;
+  return disk_slot_cnt + idx;
+}
+
+/* Returns the page in cache slot SLOT, or a null pointer if
+   SLOT is a disk slot. */
+static struct zpage *
+zslot_page (size_t slot) 
+{
+  ASSERT (lock_held_by_current_thread (&swap_lock));
+
+  if (slot < disk_slot_cnt)
+    return NULL;
+  ASSERT (slot - disk_slot_cnt < zslot_cnt);
+  ASSERT (zslots[slot - disk_slot_cnt] != NULL);
+  return zslots[slot - disk_slot_cnt];
+}
+
+/* Drops a reference to swap slot SLOT, releasing the slot, and
+   the disk slot that a cached page spilled to, if that was the
+   last one. */
+static void
+free_slot (size_t slot) 
+{
+  struct zpage *z;
+
+  lock_acquire (&swap_lock);
+  z = zslot_page (slot);
+  if (z == NULL) 
+    {
+      ASSERT (bitmap_test (swap_bitmap, slot));
+      ASSERT (swap_refs[slot] > 0);
+      if (--swap_refs[slot] == 0) 
+        bitmap_reset (swap_bitmap, slot);
+    }
+  else
+    {
+      ASSERT (z->ref_cnt > 0);
+      if (--z->ref_cnt == 0) 
+        {
+          /* A page being spilled is freed by spill(), once it
+             is done with it. */
+          zslots[slot - disk_slot_cnt] = NULL;
+          if (!z->spilling) 
+            {
+              if (z->data != NULL) 
+                {
+                  list_remove (&z->elem);
+                  cache_bytes -= sizeof *z + z->size;
+                  free (z->data);
+                }
+              else
+                bitmap_reset (swap_bitmap, z->disk_slot);
+              free (z);
+            }
+        }
+    }
+  lock_release (&swap_lock);
+}
+
+/* Writes the page at KPAGE to disk slot SLOT. */
+static void
+write_slot (size_t slot, const void *kpage) 
+{
+  size_t i;
+
+  for (i = 0; i < PAGE_SECTORS; i++)
+    block_write (swap_device, slot * PAGE_SECTORS + i,
+                 (const uint8_t *) kpage + i * BLOCK_SECTOR_SIZE);
+}
+
+/* Reads the page in disk slot SLOT into KPAGE. */
+static void
+read_slot (size_t slot, void *kpage) 
+{
+  size_t i;
+
+  for (i = 0; i < PAGE_SECTORS; i++)
+    block_read (swap_device, slot * PAGE_SECTORS + i,
+                (uint8_t *) kpage + i * BLOCK_SECTOR_SIZE);
+}
+
+/* Writes the least recently used cached pages to disk until the
+   swap cache fits within its limit, or until the disk is full.
+
+   Each page is written without holding swap_lock, so that other
+   threads can swap pages in and out meanwhile.  While it is
+   being written, the page is off the list of cached pages, so
+   that nothing else spills it, but its compressed data stays in
+   memory, for swap_in() to use, until the write is done. */
+static void
+spill (void) 
+{
+  lock_acquire (&spill_lock);
+  lock_acquire (&swap_lock);
+  while (cache_bytes > swap_cache_limit * PGSIZE) 
+    {
+      struct zpage *z = list_entry (list_back (&zpage_list),
+                                    struct zpage, elem);
+      size_t slot = alloc_slots (1);
+
+      if (slot == BITMAP_ERROR)
+        break;
+      if (!lz_decompress (z->data, z->size, spill_buf, PGSIZE))
+        PANIC ("corrupt compressed page");
+      list_remove (&z->elem);
+      z->disk_slot = slot;
+      z->spilling = true;
+
+      lock_release (&swap_lock);
+      write_slot (slot, spill_buf);
+      lock_acquire (&swap_lock);
+
+      z->spilling = false;
+      cache_bytes -= sizeof *z + z->size;
+      free (z->data);
+      z->data = NULL;
+      spill_cnt++;
+      if (z->ref_cnt == 0) 
+        {
+          bitmap_reset (swap_bitmap, slot);
+          free (z);
+        }
+    }
+  lock_release (&swap_lock);
+  lock_release (&spill_lock);
+}
+
+/* Tries to add a compressed copy of frame F's page to the swap
+   cache, with a reference for each of F's pages.  Returns the
+   cache slot it gets, or SWAP_SLOT_NONE if the page should be
+   written to disk instead.  The caller should call spill()
+   afterward, to bring the cache back within its limit.  The
+   cache takes no more pages while it is over the limit, which
+   lasts only while spilling cannot keep up or the disk is
+   full. */
+static size_t
+cache_page (struct frame *f) 
+{
+  struct zpage *z;
+  size_t size;
+  size_t slot;
+
+  ASSERT (lock_held_by_current_thread (&swap_lock));
+
+  if (swap_cache_limit == 0 || cache_bytes > swap_cache_limit * PGSIZE)
+    return SWAP_SLOT_NONE;
+  size = lz_compress (f->base, PGSIZE, compress_buf, sizeof compress_buf);
+  if (size == 0)
+    return SWAP_SLOT_NONE;
+  z = malloc (sizeof *z);
+  if (z == NULL)
+    return SWAP_SLOT_NONE;
+  z->data = malloc (size);
+  if (z->data == NULL)
+    goto no_slot;
+  slot = alloc_zslot (z);
+  if (slot == SWAP_SLOT_NONE)
+    goto no_slot;
+  z->ref_cnt = f->ref_cnt;
+  z->disk_slot = SWAP_SLOT_NONE;
+  z->spilling = false;
+  z->size = size;
+  memcpy (z->data, compress_buf, size);
+
+  list_push_front (&zpage_list, &z->elem);
+  cache_bytes += sizeof *z + size;
+  compressed_cnt++;
+  compressed_bytes += size;
+  return slot;
+
+ no_slot:
+  free (z->data);
+  free (z);
+  return SWAP_SLOT_NONE;
+}
+
+/* Swaps in page P, which must have a locked frame
+   (and be swapped out).  P gives up its reference to its swap
+   slot. */
+void
+swap_in (struct page *p) 
+{
+  struct zpage *z;
+  size_t disk_slot = p->swap_slot;
+
+  ASSERT (p->frame != NULL);
+  ASSERT (lock_held_by_current_thread (&p->frame->lock));
+  ASSERT (p->swap_slot != SWAP_SLOT_NONE);
+
+  /* Data that is on disk stays there until its slot is freed,
+     which P's reference prevents, so the disk read needs no
+     lock. */
+  lock_acquire (&swap_lock);
+  z = zslot_page (p->swap_slot);
+  if (z != NULL && z->data != NULL) 
+    {
+      if (!lz_decompress (z->data, z->size, p->frame->base, PGSIZE))
+        PANIC ("swap slot %zu: corrupt compressed page", p->swap_slot);
+      if (!z->spilling) 
+        {
+          list_remove (&z->elem);
+          list_push_front (&zpage_list, &z->elem);
+        }
+      disk_slot = SWAP_SLOT_NONE;
+      hit_cnt++;
+    }
+  else 
+    {
+      if (z != NULL)
+        disk_slot = z->disk_slot;
+      miss_cnt++;
+    }
+  lock_release (&swap_lock);
+
+  if (disk_slot != SWAP_SLOT_NONE)
+    read_slot (disk_slot, p->frame->base);
+  free_slot (p->swap_slot);
+  p->swap_slot = SWAP_SLOT_NONE;
+}
+
+/* Makes each page in frame F refer to swap slot SLOT. */
+static void
+set_slot (struct frame *f, size_t slot) 
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    list_entry (e, struct page, frame_elem)->swap_slot = slot;
+}
+
+/* Writes the CNT frames in FRAMES[] to swap, each of which must
+   be locked.  Frames that compress well go into the swap cache.
+   The others are written to contiguous disk slots, in order, so
+   that the disk sees one sequential stream of writes.  If swap
+   is too fragmented for that, they are split across as few runs
+   of slots as possible.
+
+   Returns the number of frames written, which is less than CNT
+   only if swap is full.  Each page of a frame written records
+   its slot in `swap_slot'; the pages of the others keep
+   SWAP_SLOT_NONE there. */
+size_t
+swap_out_cluster (struct frame *frames[], size_t cnt) 
+{
+  struct frame *rest[SWAP_CLUSTER];
+  size_t rest_cnt = 0;
+  size_t done = 0;
+  size_t i;
+
+  ASSERT (cnt <= SWAP_CLUSTER);
+
+  /* Cache the frames that compress well. */
+  for (i = 0; i < cnt; i++) 
+    {
+      struct frame *f = frames[i];
+      size_t slot;
+
+      ASSERT (lock_held_by_current_thread (&f->lock));
+
+      lock_acquire (&swap_lock);
+      slot = cache_page (f);
+      lock_release (&swap_lock);
+      if (slot != SWAP_SLOT_NONE) 
+        {
+          set_slot (f, slot);
+          done++;
+        }
+      else
+        rest[rest_cnt++] = f;
+    }
+  spill ();
+
+  /* Write the others to disk. */
+  for (i = 0; i < rest_cnt; ) 
+    {
+      size_t run = rest_cnt - i;
+      size_t slot;
+      size_t j;
+
+      lock_acquire (&swap_lock);
+      while ((slot = alloc_slots (run)) == BITMAP_ERROR && run > 1)
+        run /= 2;
+      if (slot != BITMAP_ERROR) 
+        {
+          for (j = 0; j < run; j++)
+            swap_refs[slot + j] = rest[i + j]->ref_cnt;
+          uncompressed_cnt += run;
+        }
+      lock_release (&swap_lock);
+      if (slot == BITMAP_ERROR)
+        break;
+
+      for (j = 0; j < run; j++) 
+        {
+          write_slot (slot + j, rest[i + j]->base);
+          set_slot (rest[i + j], slot + j);
+        }
+      i += run;
+      done += run;
+    }
+  return done;
+}
+
+/* Makes page P, which must not be in swap, share swap slot SLOT
+   with the pages that already refer to it. */
+void
+swap_share (struct page *p, size_t slot) 
+{
+  struct zpage *z;
+
+  ASSERT (p->swap_slot == SWAP_SLOT_NONE);
+
+  lock_acquire (&swap_lock);
+  z = zslot_page (slot);
+  if (z == NULL) 
+    {
+      ASSERT (bitmap_test (swap_bitmap, slot));
+      ASSERT (swap_refs[slot] < UINT16_MAX);
+      swap_refs[slot]++;
+    }
+  else
+    z->ref_cnt++;
+  lock_release (&swap_lock);
+  p->swap_slot = slot;
+}
+
+/* Drops page P's reference to the swap slot that holds its
+   data, if any, releasing the slot if P was the last page to
+   refer to it. */
+void
+swap_discard (struct page *p) 
+{
+  if (p->swap_slot != SWAP_SLOT_NONE) 
+    {
+      free_slot (p->swap_slot);
+      p->swap_slot = SWAP_SLOT_NONE;
+    }
+}
+
+/* Prints swap cache statistics. */
+void
+swap_print_stats (void) 
+{
+  printf ("Swap: %lld pages compressed to %lld%%, %lld uncompressed, "
+          "%lld spilled\n",
+          compressed_cnt,
+          (compressed_cnt
+           ? compressed_bytes * 100 / (compressed_cnt * PGSIZE) : 0),
+          uncompressed_cnt, spill_cnt);
+  printf ("Swap: %lld cache hits, %lld misses\n", hit_cnt, miss_cnt);
+}
@@ -0,0 +1,29 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct frame;
+struct page;
+
+/* Swap slot index that indicates no slot. */
+#define SWAP_SLOT_NONE ((size_t) -1)
+
+/* Maximum number of pages that eviction gathers into a single
+   contiguous write to swap. */
+#define SWAP_CLUSTER 8
+
+/* Default limit on the size of the compressed swap cache, in
+   pages. */
+#define SWAP_CACHE_DEFAULT 64
+extern size_t swap_cache_limit;
+
+void swap_init (void);
+void swap_in (struct page *);
+size_t swap_out_cluster (struct frame *[], size_t cnt);
+void swap_share (struct page *, size_t slot);
+void swap_discard (struct page *);
+void swap_print_stats (void);
+
+#endif /* vm/swap.h */